@@ -0,0 +1,287 @@
+#include "BatchChip8.h"
+#include "Session.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Batch runner: runs many instances of one ROM, each with its own random input, on the lockstep
+// batch engine and then one at a time on the scalar engine, checks they end in the same state and
+// compares instances/sec. Only links the core, no SFML.
+
+const unsigned int DEFAULT_INSTRUCTIONS_PER_FRAME = 10;
+const unsigned int KEY_CHANGE_ODDS = 8;	//an instance changes one key on 1 frame in this many
+
+// the input variations: per instance, random key changes from a generator seeded by seed + instance
+// (the instance's Cxkk generator gets seed + instance too)
+static std::vector<KeyEvent> randomInput(uint64_t seed, unsigned int instance, uint64_t frames)
+{
+	std::mt19937_64 rng(seed + instance);
+	std::vector<KeyEvent> events;
+	for (uint64_t frame = 0; frame < frames; ++frame)
+	{
+		if (rng() % KEY_CHANGE_ODDS == 0)
+		{
+			events.push_back({ frame, static_cast<uint8_t>(rng() % KEY_COUNT), static_cast<uint8_t>(rng() % 2) });
+		}
+	}
+	return events;
+}
+
+// one instance's key change
+struct InstanceEvent
+{
+	unsigned int instance;
+	KeyEvent event;
+};
+
+// runSession for every instance at once; events are every instance's input merged in frame order,
+// so a frame only costs the changes due in it rather than a look at every instance
+static void runBatch(BatchChip8& batch, uint64_t cycles, unsigned int instructionsPerFrame,
+	const std::vector<InstanceEvent>& events)
+{
+	size_t nextEvent = 0;
+	uint64_t executed = 0;
+	uint64_t frame = 0;
+
+	while (executed < cycles)
+	{
+		while (nextEvent < events.size() && events[nextEvent].event.frame <= frame)
+		{
+			const InstanceEvent& change = events[nextEvent];
+			batch.getKeypad(change.instance)[change.event.key] = change.event.state;
+			++nextEvent;
+		}
+
+		uint64_t count = std::min<uint64_t>(instructionsPerFrame, cycles - executed);
+		if (count == instructionsPerFrame)
+		{
+			batch.runFrame(instructionsPerFrame);
+		}
+		else
+		{
+			batch.run(static_cast<unsigned int>(count));
+		}
+		executed += count;
+		++frame;
+	}
+}
+
+// what differs between an instance of the batch and the scalar run of it, or nullptr
+static const char* compare(BatchChip8& batch, unsigned int instance, Chip8& chip8)
+{
+	if (batch.getProgramCounter(instance) != chip8.getProgramCounter())
+	{
+		return "pc";
+	}
+	if (batch.getIndex(instance) != chip8.getIndex())
+	{
+		return "index";
+	}
+	if (batch.getStackPointer(instance) != chip8.getStackPointer())
+	{
+		return "sp";
+	}
+	if (batch.getDelayTimer(instance) != chip8.getDelayTimer())
+	{
+		return "delay timer";
+	}
+	for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+	{
+		if (batch.getRegister(instance, r) != chip8.getRegisters()[r])
+		{
+			return "registers";
+		}
+	}
+	for (unsigned int level = 0; level < STACK_LEVELS; ++level)
+	{
+		if (batch.getStack(instance, level) != chip8.getStack()[level])
+		{
+			return "stack";
+		}
+	}
+	if (!std::equal(chip8.getMemory(), chip8.getMemory() + MEMORY_SIZE, batch.getMemory(instance)))
+	{
+		return "memory";
+	}
+	if (hashVideo(batch.getVideo(instance), sizeof(chip8.video)) != hashVideo(chip8.getVideo(), sizeof(chip8.video)))
+	{
+		return "video";
+	}
+	return nullptr;
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " <ROM> <Instances> (--cycles <N> | --frames <N>) [--ipf <N>] [--seed <N>]"
+		" [--engine table|cached|jit|switch] [--no-simd]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 5)
+	{
+		usage(argv[0]);
+	}
+
+	std::string romFile = argv[1];
+	unsigned int instances = std::stoul(argv[2]);
+	uint64_t cycles = 0;
+	uint64_t frames = 0;
+	uint64_t seed = 1;
+	unsigned int instructionsPerFrame = DEFAULT_INSTRUCTIONS_PER_FRAME;
+	Chip8::Engine engine = Chip8::Engine::Table;
+	bool simd = true;
+
+	for (int i = 3; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--no-simd")
+		{
+			simd = false;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			usage(argv[0]);
+		}
+		if (arg == "--cycles")
+		{
+			cycles = std::stoull(argv[++i]);
+		}
+		else if (arg == "--frames")
+		{
+			frames = std::stoull(argv[++i]);
+		}
+		else if (arg == "--ipf")
+		{
+			instructionsPerFrame = std::stoul(argv[++i]);
+		}
+		else if (arg == "--seed")
+		{
+			seed = std::stoull(argv[++i]);
+		}
+		else if (arg == "--engine")
+		{
+			std::string name = argv[++i];
+			if (name == "table")
+			{
+				engine = Chip8::Engine::Table;
+			}
+			else if (name == "cached")
+			{
+				engine = Chip8::Engine::Cached;
+			}
+			else if (name == "jit")
+			{
+				engine = Chip8::Engine::Jit;
+			}
+			else if (name == "switch")
+			{
+				engine = Chip8::Engine::Switch;
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	if (instances == 0 || (cycles == 0) == (frames == 0) || instructionsPerFrame == 0)
+	{
+		usage(argv[0]);
+	}
+	if (frames != 0)
+	{
+		cycles = frames * instructionsPerFrame;
+	}
+	frames = (cycles + instructionsPerFrame - 1) / instructionsPerFrame;
+
+	std::ifstream romStream(romFile, std::ios::binary);
+	if (!romStream.is_open())
+	{
+		std::cerr << "Could not open ROM " << romFile << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(romStream)), std::istreambuf_iterator<char>());
+
+	std::vector<std::vector<KeyEvent>> inputs;
+	std::vector<InstanceEvent> merged;
+	for (unsigned int i = 0; i < instances; ++i)
+	{
+		inputs.push_back(randomInput(seed, i, frames));
+		for (const KeyEvent& event : inputs.back())
+		{
+			merged.push_back({ i, event });
+		}
+	}
+	std::stable_sort(merged.begin(), merged.end(),
+		[](const InstanceEvent& a, const InstanceEvent& b) { return a.event.frame < b.event.frame; });
+
+	BatchChip8 batch(instances);
+	batch.setSimd(simd);
+	for (unsigned int i = 0; i < instances; ++i)
+	{
+		batch.setSeed(i, seed + i);
+	}
+	if (!batch.loadROM(rom.data(), rom.size()))
+	{
+		std::cerr << "ROM is too large." << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	auto start = std::chrono::steady_clock::now();
+	runBatch(batch, cycles, instructionsPerFrame, merged);
+	double batchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	//the same instances one at a time, compared as each one finishes
+	double scalarSeconds = 0;
+	unsigned int mismatches = 0;
+	for (unsigned int i = 0; i < instances; ++i)
+	{
+		Chip8 chip8;
+		chip8.setEngine(engine);
+		chip8.setSeed(seed + i);
+		chip8.loadROM(rom.data(), rom.size());
+		start = std::chrono::steady_clock::now();
+		runSession(chip8, cycles, instructionsPerFrame, inputs[i]);
+		scalarSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		const char* difference = compare(batch, i, chip8);
+		if (difference != nullptr)
+		{
+			if (mismatches < 10)
+			{
+				std::cout << "Instance " << i << " differs: " << difference << "\n";
+			}
+			++mismatches;
+		}
+	}
+
+	double total = static_cast<double>(cycles) * instances;
+	std::cout << "Instances: " << instances << "\n";
+	std::cout << "Instructions per instance: " << cycles << "\n";
+	std::cout << "Kernels: " << (batch.simdActive() ? "AVX2" : "scalar") << "\n";
+	std::cout << "Lockstep width: " << std::fixed << std::setprecision(2)
+		<< (batch.getGroupSteps() > 0 ? static_cast<double>(batch.getLaneSteps()) / batch.getGroupSteps() : 0.0) << "\n";
+	std::cout << "Batch time: " << std::setprecision(6) << batchSeconds << " s\n";
+	std::cout << "Batch instances/sec: " << std::setprecision(1) << (batchSeconds > 0 ? instances / batchSeconds : 0.0) << "\n";
+	std::cout << "Batch instructions/sec: " << std::setprecision(0) << (batchSeconds > 0 ? total / batchSeconds : 0.0) << "\n";
+	std::cout << "Scalar time: " << std::setprecision(6) << scalarSeconds << " s\n";
+	std::cout << "Scalar instances/sec: " << std::setprecision(1) << (scalarSeconds > 0 ? instances / scalarSeconds : 0.0) << "\n";
+	std::cout << "Scalar instructions/sec: " << std::setprecision(0) << (scalarSeconds > 0 ? total / scalarSeconds : 0.0) << "\n";
+	std::cout << "Speedup: " << std::setprecision(2) << (batchSeconds > 0 ? scalarSeconds / batchSeconds : 0.0) << "\n";
+	std::cout << "Mismatches: " << mismatches << std::endl;
+
+	return mismatches == 0 ? 0 : EXIT_FAILURE;
+}
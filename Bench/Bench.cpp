@@ -0,0 +1,591 @@
+#include "Chip8.h"
+#include "Pixels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Microbenchmarks: every opcode handler, sprite drawing, engine dispatch, loadROM and the
+// video to RGBA conversion. Each benchmark is calibrated to a minimum time per repetition, warmed
+// up, then timed over repeated runs and reported as a mean with a 95% confidence interval.
+// Results can be written as CSV and checked against the CSV of another build. Only links the core, no SFML.
+
+const unsigned int DEFAULT_REPETITIONS = 15;
+const unsigned int DEFAULT_WARMUP = 3;
+const double DEFAULT_MIN_SECONDS = 0.01;	//per repetition
+const double REGRESSION_THRESHOLD = 0.05;	//slower than the baseline by more than this, intervals apart
+const unsigned int LOOP_OPCODES = 64;	//straight-line opcodes per pass of a benchmark ROM
+const unsigned int RESTART_INSTRUCTIONS = 256;	//run from boot per restart benchmark iteration
+
+// one thing to time: run(iterations) does exactly iterations units of work (instructions, calls)
+struct Benchmark
+{
+	std::string name;
+	const char* unit;
+	std::function<void(uint64_t)> run;
+};
+
+struct Result
+{
+	std::string name;
+	const char* unit;
+	double mean;	//ns per unit
+	double interval;	//95% confidence half-width, ns
+	double deviation;
+	double minimum;
+	unsigned int repetitions;
+	uint64_t iterations;	//per repetition
+};
+
+static std::vector<uint8_t> assemble(const std::vector<uint16_t>& opcodes)
+{
+	std::vector<uint8_t> rom;
+	for (uint16_t opcode : opcodes)
+	{
+		rom.push_back(static_cast<uint8_t>(opcode >> 8));
+		rom.push_back(static_cast<uint8_t>(opcode & 0xFF));
+	}
+	return rom;
+}
+
+// prologue, then body repeated up to LOOP_OPCODES opcodes, then a jump back to the first body opcode;
+// the prologue runs once at setup, so timed instructions are the body's plus one jump per pass
+static std::vector<uint16_t> loop(const std::vector<uint16_t>& prologue, const std::vector<uint16_t>& body)
+{
+	std::vector<uint16_t> program = prologue;
+	uint16_t start = static_cast<uint16_t>(START_ADDRESS + 2 * program.size());
+	while (program.size() - prologue.size() + body.size() <= LOOP_OPCODES)
+	{
+		program.insert(program.end(), body.begin(), body.end());
+	}
+	program.push_back(0x1000 | start);
+	return program;
+}
+
+// run program on a fresh machine with the given engine: the prologue once at setup, then
+// iterations instructions per call
+static Benchmark programBenchmark(const std::string& name, Chip8::Engine engine, const std::vector<uint16_t>& program,
+	unsigned int prologueLength, bool packedVideo = false)
+{
+	auto chip8 = std::make_shared<Chip8>();
+	chip8->setEngine(engine);
+	chip8->setPackedVideo(packedVideo);
+	chip8->setSeed(0);
+	std::vector<uint8_t> rom = assemble(program);
+	chip8->loadROM(rom.data(), rom.size());
+	//key 0 held and the rest up, so Ex9E on V1 and ExA1 on V0 fall through and Fx0A doesn't wait
+	chip8->keypad[0] = 1;
+	chip8->run(prologueLength);
+	return { name, "instruction", [chip8](uint64_t iterations)
+		{
+			while (iterations > 0)
+			{
+				unsigned int count = static_cast<unsigned int>(std::min<uint64_t>(iterations, 1u << 30));
+				chip8->run(count);
+				iterations -= count;
+			}
+		} };
+}
+
+static void addHandlers(std::vector<Benchmark>& benchmarks)
+{
+	// straight-line opcodes, set up so that skips fall through; I points at free memory for the
+	// stores and loads
+	struct Case
+	{
+		const char* kind;
+		std::vector<uint16_t> prologue;
+		std::vector<uint16_t> body;
+	};
+	const std::vector<Case> cases = {
+		{ "Null", {}, { 0x0000 } },
+		{ "00E0", {}, { 0x00E0 } },
+		{ "3xkk", {}, { 0x3A01 } },
+		{ "4xkk", {}, { 0x4A00 } },
+		{ "5xy0", { 0x6B01 }, { 0x5AB0 } },
+		{ "6xkk", {}, { 0x6A02 } },
+		{ "7xkk", {}, { 0x7A01 } },
+		{ "8xy0", {}, { 0x8AB0 } },
+		{ "8xy1", {}, { 0x8AB1 } },
+		{ "8xy2", {}, { 0x8AB2 } },
+		{ "8xy3", {}, { 0x8AB3 } },
+		{ "8xy4", {}, { 0x8AB4 } },
+		{ "8xy5", {}, { 0x8AB5 } },
+		{ "8xy6", {}, { 0x8AB6 } },
+		{ "8xy7", {}, { 0x8AB7 } },
+		{ "8xyE", {}, { 0x8ABE } },
+		{ "9xy0", {}, { 0x9AB0 } },
+		{ "Annn", {}, { 0xA300 } },
+		{ "Cxkk", {}, { 0xCAFF } },
+		{ "Dxyn", { 0xA050 }, { 0xDAB5 } },
+		{ "Ex9E", { 0x6A01 }, { 0xEA9E } },
+		{ "ExA1", {}, { 0xEAA1 } },
+		{ "Fx07", {}, { 0xFA07 } },
+		{ "Fx0A", {}, { 0xFA0A } },
+		{ "Fx15", {}, { 0xFA15 } },
+		{ "Fx18", {}, { 0xFA18 } },
+		{ "Fx1E", {}, { 0xFA1E } },
+		{ "Fx29", {}, { 0xFA29 } },
+		{ "Fx33", { 0xA800 }, { 0xFA33 } },
+		{ "Fx55", { 0xA800 }, { 0xFF55 } },
+		{ "Fx65", { 0xA800 }, { 0xFF65 } },
+	};
+	for (const Case& c : cases)
+	{
+		benchmarks.push_back(programBenchmark(std::string("handler/") + c.kind, Chip8::Engine::Table,
+			loop(c.prologue, c.body), static_cast<unsigned int>(c.prologue.size())));
+	}
+
+	// control flow: chains of jumps to the next opcode, and calls to a subroutine that returns
+	std::vector<uint16_t> jumps;
+	std::vector<uint16_t> offsetJumps = { 0x6000 };
+	for (unsigned int i = 1; i < LOOP_OPCODES; ++i)
+	{
+		jumps.push_back(static_cast<uint16_t>(0x1000 | (START_ADDRESS + 2 * i)));
+		offsetJumps.push_back(static_cast<uint16_t>(0xB000 | (START_ADDRESS + 2 * (i + 1))));
+	}
+	jumps.push_back(0x1000 | START_ADDRESS);
+	offsetJumps.push_back(0x1000 | (START_ADDRESS + 2));
+	benchmarks.push_back(programBenchmark("handler/1nnn", Chip8::Engine::Table, jumps, 0));
+	benchmarks.push_back(programBenchmark("handler/Bnnn", Chip8::Engine::Table, offsetJumps, 1));
+
+	const uint16_t subroutine = START_ADDRESS + 2 * (LOOP_OPCODES + 1);
+	std::vector<uint16_t> calls = loop({}, { static_cast<uint16_t>(0x2000 | subroutine) });
+	calls.resize(LOOP_OPCODES + 1, 0x0000);
+	calls.push_back(0x00EE);
+	benchmarks.push_back(programBenchmark("handler/2nnn+00EE", Chip8::Engine::Table, calls, 0));
+}
+
+static void addDrawing(std::vector<Benchmark>& benchmarks)
+{
+	struct Position
+	{
+		const char* name;
+		uint8_t x;
+		uint8_t y;
+	};
+	const Position positions[] = { { "aligned", 0, 0 }, { "unaligned", 3, 7 }, { "clipped", 60, 30 } };
+	const uint8_t heights[] = { 1, 5, 15 };
+
+	for (bool packed : { false, true })
+	{
+		for (uint8_t height : heights)
+		{
+			for (const Position& position : positions)
+			{
+				//I at the ROM itself gives 15 rows of sprite data
+				std::vector<uint16_t> prologue = { static_cast<uint16_t>(0x6000 | position.x),
+					static_cast<uint16_t>(0x6100 | position.y), static_cast<uint16_t>(0xA000 | START_ADDRESS) };
+				std::ostringstream name;
+				name << "draw/h" << static_cast<unsigned int>(height) << "-" << position.name << (packed ? "-packed" : "");
+				benchmarks.push_back(programBenchmark(name.str(), Chip8::Engine::Table,
+					loop(prologue, { static_cast<uint16_t>(0xD010 | height) }), 3, packed));
+			}
+		}
+	}
+}
+
+static void addDispatch(std::vector<Benchmark>& benchmarks)
+{
+	//a mix of ALU, skip and index instructions
+	const std::vector<uint16_t> body = { 0x6A05, 0x7A01, 0x6B03, 0x8AB4, 0x3A00, 0x8AB2, 0x8AB3, 0xA300, 0xFA1E };
+	const std::pair<const char*, Chip8::Engine> engines[] = { { "table", Chip8::Engine::Table },
+		{ "cached", Chip8::Engine::Cached }, { "switch", Chip8::Engine::Switch }, { "jit", Chip8::Engine::Jit } };
+	for (const auto& engine : engines)
+	{
+		benchmarks.push_back(programBenchmark(std::string("dispatch/") + engine.first, engine.second, loop({}, body), 0));
+	}
+}
+
+static void addLoadROM(std::vector<Benchmark>& benchmarks)
+{
+	const std::pair<const char*, size_t> sizes[] = { { "small", 256 }, { "full", MEMORY_SIZE - START_ADDRESS } };
+	const std::pair<const char*, Chip8::Engine> engines[] = { { "table", Chip8::Engine::Table }, { "jit", Chip8::Engine::Jit } };
+	for (const auto& size : sizes)
+	{
+		for (const auto& engine : engines)
+		{
+			auto chip8 = std::make_shared<Chip8>();
+			chip8->setEngine(engine.second);
+			auto rom = std::make_shared<std::vector<uint8_t>>(size.second, static_cast<uint8_t>(0x12));
+			benchmarks.push_back({ std::string("loadROM/") + size.first + "-" + engine.first, "call",
+				[chip8, rom](uint64_t iterations)
+				{
+					for (uint64_t i = 0; i < iterations; ++i)
+					{
+						chip8->loadROM(rom->data(), rom->size());
+					}
+				} });
+		}
+	}
+}
+
+// a short run from boot, the way a test farm restarts one ROM over and over: a new machine and
+// loadROM each time against reset() on one machine
+static void addRestart(std::vector<Benchmark>& benchmarks)
+{
+	//stores as well as ALU work, so reset has memory to put back
+	auto rom = std::make_shared<std::vector<uint8_t>>(assemble(loop({ 0xA400 }, { 0x7001, 0x8014, 0xF355 })));
+	const std::pair<const char*, Chip8::Engine> engines[] = { { "table", Chip8::Engine::Table }, { "jit", Chip8::Engine::Jit } };
+	for (const auto& engine : engines)
+	{
+		Chip8::Engine e = engine.second;
+		benchmarks.push_back({ std::string("restart/construct-") + engine.first, "restart",
+			[rom, e](uint64_t iterations)
+			{
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					Chip8 chip8;
+					chip8.setEngine(e);
+					chip8.setSeed(0);
+					chip8.loadROM(rom->data(), rom->size());
+					chip8.run(RESTART_INSTRUCTIONS);
+				}
+			} });
+
+		auto chip8 = std::make_shared<Chip8>();
+		chip8->setEngine(e);
+		chip8->setSeed(0);
+		chip8->loadROM(rom->data(), rom->size());
+		benchmarks.push_back({ std::string("restart/reset-") + engine.first, "restart",
+			[chip8](uint64_t iterations)
+			{
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					chip8->reset();
+					chip8->run(RESTART_INSTRUCTIONS);
+				}
+			} });
+	}
+}
+
+// the byte-at-a-time loop videoToRGBA replaced, kept as the baseline its kernels are measured against
+static void legacyVideoToRGBA(const uint8_t* video, uint8_t* pixels, unsigned int firstRow, unsigned int rows)
+{
+	for (unsigned int i = firstRow * VIDEO_WIDTH * 4; i < (firstRow + rows) * VIDEO_WIDTH * 4; i += 4)
+	{
+		uint8_t value = video[i / 4] == 0xFF ? 0xFF : 0x00;
+		pixels[i] = value;
+		pixels[i + 1] = value;
+		pixels[i + 2] = value;
+		pixels[i + 3] = value;
+	}
+}
+
+const std::pair<PixelKernel, const char*> PIXEL_KERNELS[] =
+{
+	{ PixelKernel::Scalar, "scalar" },
+	{ PixelKernel::Sse2, "sse2" },
+	{ PixelKernel::Avx2, "avx2" },
+};
+
+static void addPixels(std::vector<Benchmark>& benchmarks)
+{
+	const unsigned int maxScale = 10;
+	auto video = std::make_shared<std::vector<uint8_t>>(VIDEO_WIDTH * VIDEO_HEIGHT);
+	auto pixels = std::make_shared<std::vector<uint8_t>>(VIDEO_WIDTH * VIDEO_HEIGHT * 4 * maxScale * maxScale);
+	std::mt19937 rng(1);
+	for (uint8_t& pixel : *video)
+	{
+		pixel = rng() % 2 ? 0xFF : 0x00;
+	}
+	for (unsigned int rows : { 1u, VIDEO_HEIGHT })
+	{
+		std::string name = rows == 1 ? "pixels/rgba-row" : "pixels/rgba-frame";
+		benchmarks.push_back({ name + "-legacy", "call",
+			[video, pixels, rows](uint64_t iterations)
+			{
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					legacyVideoToRGBA(video->data(), pixels->data(), static_cast<unsigned int>(i % (VIDEO_HEIGHT - rows + 1)), rows);
+				}
+			} });
+		// unsuffixed: whichever kernel videoToRGBA picks on this machine
+		benchmarks.push_back({ name, "call",
+			[video, pixels, rows](uint64_t iterations)
+			{
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					videoToRGBA(video->data(), pixels->data(), static_cast<unsigned int>(i % (VIDEO_HEIGHT - rows + 1)), rows);
+				}
+			} });
+		for (const auto& kernel : PIXEL_KERNELS)
+		{
+			if (!isPixelKernelAvailable(kernel.first))
+			{
+				continue;
+			}
+			PixelKernel pixelKernel = kernel.first;
+			benchmarks.push_back({ name + "-" + kernel.second, "call",
+				[video, pixels, rows, pixelKernel](uint64_t iterations)
+				{
+					for (uint64_t i = 0; i < iterations; ++i)
+					{
+						videoToRGBA(pixelKernel, video->data(), pixels->data(), static_cast<unsigned int>(i % (VIDEO_HEIGHT - rows + 1)), rows);
+					}
+				} });
+		}
+	}
+	// the window's usual scales; x10 per kernel as well, against the old scaled path (scalar)
+	for (unsigned int scale : { 2u, 4u, maxScale })
+	{
+		std::string name = "pixels/rgba-frame-x" + std::to_string(scale);
+		benchmarks.push_back({ name, "call",
+			[video, pixels, scale](uint64_t iterations)
+			{
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					videoToRGBA(video->data(), pixels->data(), 0, VIDEO_HEIGHT, DEFAULT_PALETTE, scale);
+				}
+			} });
+		for (const auto& kernel : PIXEL_KERNELS)
+		{
+			if (scale != maxScale || !isPixelKernelAvailable(kernel.first))
+			{
+				continue;
+			}
+			PixelKernel pixelKernel = kernel.first;
+			benchmarks.push_back({ name + "-" + kernel.second, "call",
+				[video, pixels, scale, pixelKernel](uint64_t iterations)
+				{
+					for (uint64_t i = 0; i < iterations; ++i)
+					{
+						videoToRGBA(pixelKernel, video->data(), pixels->data(), 0, VIDEO_HEIGHT, DEFAULT_PALETTE, scale);
+					}
+				} });
+		}
+	}
+}
+
+// two-sided 95% Student's t for degrees of freedom 1-30, the normal value past that
+static double studentT(unsigned int degrees)
+{
+	static const double table[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+	return degrees >= 1 && degrees <= 30 ? table[degrees - 1] : 1.960;
+}
+
+static double timeRun(const Benchmark& benchmark, uint64_t iterations)
+{
+	auto start = std::chrono::steady_clock::now();
+	benchmark.run(iterations);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Result measure(const Benchmark& benchmark, unsigned int repetitions, unsigned int warmup, double minSeconds)
+{
+	//grow the iteration count until one repetition takes minSeconds
+	uint64_t iterations = 1;
+	double seconds = timeRun(benchmark, iterations);
+	while (seconds < minSeconds)
+	{
+		double scale = seconds > 0 ? minSeconds / seconds * 1.2 : 10.0;
+		iterations = static_cast<uint64_t>(iterations * std::min(std::max(scale, 1.5), 10.0)) + 1;
+		seconds = timeRun(benchmark, iterations);
+	}
+
+	for (unsigned int i = 0; i < warmup; ++i)
+	{
+		timeRun(benchmark, iterations);
+	}
+
+	std::vector<double> samples;
+	for (unsigned int i = 0; i < repetitions; ++i)
+	{
+		samples.push_back(timeRun(benchmark, iterations) * 1e9 / iterations);
+	}
+
+	Result result{ benchmark.name, benchmark.unit, 0, 0, 0, samples[0], repetitions, iterations };
+	for (double sample : samples)
+	{
+		result.mean += sample / samples.size();
+		result.minimum = std::min(result.minimum, sample);
+	}
+	if (samples.size() > 1)
+	{
+		double squares = 0;
+		for (double sample : samples)
+		{
+			squares += (sample - result.mean) * (sample - result.mean);
+		}
+		result.deviation = std::sqrt(squares / (samples.size() - 1));
+		result.interval = studentT(static_cast<unsigned int>(samples.size() - 1)) * result.deviation / std::sqrt(samples.size());
+	}
+	return result;
+}
+
+static bool writeCsv(const std::string& file, const std::vector<Result>& results)
+{
+	std::ofstream out(file, std::ios::trunc);
+	if (!out.is_open())
+	{
+		return false;
+	}
+	out << "name,unit,mean_ns,ci95_ns,stddev_ns,min_ns,repetitions,iterations\n";
+	out << std::setprecision(6);
+	for (const Result& result : results)
+	{
+		out << result.name << "," << result.unit << "," << result.mean << "," << result.interval << ","
+			<< result.deviation << "," << result.minimum << "," << result.repetitions << "," << result.iterations << "\n";
+	}
+	return out.good();
+}
+
+// name -> (mean, interval) from a CSV written by writeCsv
+static bool readCsv(const std::string& file, std::map<std::string, std::pair<double, double>>& baseline)
+{
+	std::ifstream in(file);
+	if (!in.is_open())
+	{
+		std::cerr << "Could not open baseline " << file << std::endl;
+		return false;
+	}
+	std::string line;
+	std::getline(in, line);	//header
+	while (std::getline(in, line))
+	{
+		std::istringstream fields(line);
+		std::string name, unit, mean, interval;
+		if (std::getline(fields, name, ',') && std::getline(fields, unit, ',') && std::getline(fields, mean, ',')
+			&& std::getline(fields, interval, ','))
+		{
+			baseline[name] = { std::stod(mean), std::stod(interval) };
+		}
+	}
+	return true;
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " [--filter <Text>] [--repetitions <N>] [--warmup <N>] [--min-time <Seconds>]"
+		" [--csv <File>] [--baseline <File>] [--list]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	std::string csvFile;
+	std::string baselineFile;
+	unsigned int repetitions = DEFAULT_REPETITIONS;
+	unsigned int warmup = DEFAULT_WARMUP;
+	double minSeconds = DEFAULT_MIN_SECONDS;
+	bool list = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--list")
+		{
+			list = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			usage(argv[0]);
+		}
+		if (arg == "--filter")
+		{
+			filter = argv[++i];
+		}
+		else if (arg == "--repetitions")
+		{
+			repetitions = std::stoul(argv[++i]);
+		}
+		else if (arg == "--warmup")
+		{
+			warmup = std::stoul(argv[++i]);
+		}
+		else if (arg == "--min-time")
+		{
+			minSeconds = std::stod(argv[++i]);
+		}
+		else if (arg == "--csv")
+		{
+			csvFile = argv[++i];
+		}
+		else if (arg == "--baseline")
+		{
+			baselineFile = argv[++i];
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+	if (repetitions == 0)
+	{
+		usage(argv[0]);
+	}
+
+	std::map<std::string, std::pair<double, double>> baseline;
+	if (!baselineFile.empty() && !readCsv(baselineFile, baseline))
+	{
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::vector<Benchmark> benchmarks;
+	addHandlers(benchmarks);
+	addDrawing(benchmarks);
+	addDispatch(benchmarks);
+	addLoadROM(benchmarks);
+	addRestart(benchmarks);
+	addPixels(benchmarks);
+
+	std::vector<Result> results;
+	unsigned int regressions = 0;
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		if (benchmark.name.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+		if (list)
+		{
+			std::cout << benchmark.name << "\n";
+			continue;
+		}
+
+		Result result = measure(benchmark, repetitions, warmup, minSeconds);
+		results.push_back(result);
+		std::cout << std::left << std::setw(28) << result.name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << result.mean << " ns/" << std::left << std::setw(12) << result.unit << std::right
+			<< "+-" << std::setw(7) << result.interval << "  min " << std::setw(9) << result.minimum;
+
+		auto old = baseline.find(result.name);
+		if (old != baseline.end())
+		{
+			double change = (result.mean - old->second.first) / old->second.first;
+			std::cout << "  " << std::showpos << std::setprecision(1) << change * 100 << "%" << std::noshowpos;
+			if (change > REGRESSION_THRESHOLD && result.mean - result.interval > old->second.first + old->second.second)
+			{
+				std::cout << "  REGRESSION";
+				++regressions;
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	if (!csvFile.empty() && !writeCsv(csvFile, results))
+	{
+		std::cerr << "Could not write " << csvFile << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if (!baselineFile.empty())
+	{
+		std::cout << "Regressions: " << regressions << std::endl;
+	}
+	return regressions == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,722 @@
+#include "BatchChip8.h"
+#include "Semantics.h"
+#include <bitset>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CHIP8_BATCH_AVX2
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// GCC/Clang only emit AVX2 inside functions marked for it, MSVC takes the intrinsics anywhere.
+// Either way they only run after cpuHasAvx2() said so.
+#if defined(__GNUC__)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#endif
+
+struct LaneBlock
+{
+	//row r holds register r of every lane
+	alignas(32) uint8_t registers[REGISTER_COUNT][BATCH_WIDTH];
+	alignas(32) uint16_t index[BATCH_WIDTH];
+	alignas(32) uint16_t pc[BATCH_WIDTH];
+	alignas(32) uint16_t stack[STACK_LEVELS][BATCH_WIDTH];
+	uint8_t sp[BATCH_WIDTH];
+	uint8_t delayTimer[BATCH_WIDTH];
+	uint8_t soundTimer[BATCH_WIDTH];
+
+	uint8_t keypad[BATCH_WIDTH][KEY_COUNT];
+	uint8_t memory[BATCH_WIDTH][MEMORY_SIZE];
+	uint8_t video[BATCH_WIDTH][VIDEO_WIDTH * VIDEO_HEIGHT];
+
+	//every lane's memory is the same, so one fetch serves a whole group
+	bool sharedMemory;
+	//bytes some lane wrote during the current instruction, empty when writtenLast == 0
+	unsigned int writtenFirst;
+	unsigned int writtenLast;
+
+	uint64_t randomState[BATCH_WIDTH];
+};
+
+// lanes at the same pc, run together
+struct Group
+{
+	uint32_t lanes;
+	uint16_t pc;
+	unsigned int steps;	//instructions run since the lanes' remaining counts were brought up to date
+	unsigned int budget;	//steps until the first of the lanes runs out
+};
+
+static unsigned int firstLane(uint32_t lanes)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(lanes);
+#else
+	unsigned long lane;
+	_BitScanForward(&lane, lanes);
+	return lane;
+#endif
+}
+
+static bool cpuHasAvx2()
+{
+#if !defined(CHIP8_BATCH_AVX2)
+	return false;
+#elif defined(__GNUC__)
+	return __builtin_cpu_supports("avx2");
+#else
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+	//the CPU has AVX and the OS saves the YMM registers
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+// pc already masked, as in Chip8
+static uint16_t fetch(const LaneBlock& block, unsigned int lane, uint16_t pc)
+{
+	return (block.memory[lane][pc] << 8u) | block.memory[lane][(pc + 1) & ADDRESS_MASK];
+}
+
+static void markWritten(LaneBlock& block, unsigned int address, unsigned int length)
+{
+	if (address < block.writtenFirst)
+	{
+		block.writtenFirst = address;
+	}
+	if (address + length > block.writtenLast)
+	{
+		block.writtenLast = address + length;
+	}
+}
+
+// after an instruction wrote memory, see whether every lane still holds the same bytes there
+static void checkWritten(LaneBlock& block)
+{
+	if (block.writtenLast == 0)
+	{
+		return;
+	}
+	unsigned int first = block.writtenFirst;
+	unsigned int last = block.writtenLast < MEMORY_SIZE ? block.writtenLast : MEMORY_SIZE;
+	for (unsigned int lane = 1; lane < BATCH_WIDTH && block.sharedMemory && first < last; ++lane)
+	{
+		block.sharedMemory = memcmp(block.memory[lane] + first, block.memory[0] + first, last - first) == 0;
+	}
+	block.writtenFirst = MEMORY_SIZE;
+	block.writtenLast = 0;
+}
+
+// One instruction on one lane, through the same Semantics.h helpers the Chip8 handlers call;
+// returns the lane's next pc
+static uint16_t stepLane(LaneBlock& block, unsigned int lane, const Instruction& op, uint16_t pc)
+{
+	Strided<uint8_t, BATCH_WIDTH> V{ &block.registers[0][lane] };
+	Strided<uint16_t, BATCH_WIDTH> stack{ &block.stack[0][lane] };
+	uint16_t& index = block.index[lane];
+	uint8_t& sp = block.sp[lane];
+	uint8_t* memory = block.memory[lane];
+	const uint8_t* keypad = block.keypad[lane];
+
+	pc += 2;
+	switch (op.kind)
+	{
+	case OpKind::Op00E0:
+		exec00E0(block.video[lane]);
+		break;
+	case OpKind::Op00EE:
+		exec00EE(stack, sp, pc);
+		break;
+	case OpKind::Op1nnn:
+		exec1nnn(op, pc);
+		break;
+	case OpKind::Op2nnn:
+		exec2nnn(op, stack, sp, pc);
+		break;
+	case OpKind::Op3xkk:
+	case OpKind::Op4xkk:
+	case OpKind::Op5xy0:
+	case OpKind::Op9xy0:
+	case OpKind::OpEx9E:
+	case OpKind::OpExA1:
+		if (skipTaken(op, V, keypad))
+		{
+			pc += 2;
+		}
+		break;
+	case OpKind::Op6xkk:
+		exec6xkk(op, V);
+		break;
+	case OpKind::Op7xkk:
+		exec7xkk(op, V);
+		break;
+	case OpKind::Op8xy0:
+		exec8xy0(op, V);
+		break;
+	case OpKind::Op8xy1:
+		exec8xy1(op, V);
+		break;
+	case OpKind::Op8xy2:
+		exec8xy2(op, V);
+		break;
+	case OpKind::Op8xy3:
+		exec8xy3(op, V);
+		break;
+	case OpKind::Op8xy4:
+		exec8xy4(op, V);
+		break;
+	case OpKind::Op8xy5:
+		exec8xy5(op, V);
+		break;
+	case OpKind::Op8xy6:
+		exec8xy6(op, V);
+		break;
+	case OpKind::Op8xy7:
+		exec8xy7(op, V);
+		break;
+	case OpKind::Op8xyE:
+		exec8xyE(op, V);
+		break;
+	case OpKind::OpAnnn:
+		execAnnn(op, index);
+		break;
+	case OpKind::OpBnnn:
+		execBnnn(op, V, pc);
+		break;
+	case OpKind::OpCxkk:
+		execCxkk(op, V, block.randomState[lane]);
+		break;
+	case OpKind::OpDxyn:
+		execDxyn(op, V, memory, index, block.video[lane]);
+		break;
+	case OpKind::OpFx07:
+		execFx07(op, V, block.delayTimer[lane]);
+		break;
+	case OpKind::OpFx0A:
+		//no key down: run it again
+		if (!execFx0A(op, V, keypad))
+		{
+			pc -= 2;
+		}
+		break;
+	case OpKind::OpFx15:
+		execFx15(op, V, block.delayTimer[lane]);
+		break;
+	case OpKind::OpFx18:
+		execFx18(op, V, block.soundTimer[lane]);
+		break;
+	case OpKind::OpFx1E:
+		execFx1E(op, V, index);
+		break;
+	case OpKind::OpFx29:
+		execFx29(op, V, index);
+		break;
+	case OpKind::OpFx33:
+		execFx33(op, V, memory, index);
+		markWritten(block, index, 3);
+		break;
+	case OpKind::OpFx55:
+		execFx55(op, V, memory, index);
+		markWritten(block, index, op.x + 1u);
+		break;
+	case OpKind::OpFx65:
+		execFx65(op, V, memory, index);
+		break;
+	default:
+		break;
+	}
+	return pc;
+}
+
+static bool isVectorSkip(OpKind kind)
+{
+	return kind == OpKind::Op3xkk || kind == OpKind::Op4xkk || kind == OpKind::Op5xy0 || kind == OpKind::Op9xy0;
+}
+
+static bool isVectorAlu(OpKind kind)
+{
+	return (kind >= OpKind::Op6xkk && kind <= OpKind::Op8xyE) || kind == OpKind::OpAnnn;
+}
+
+#ifdef CHIP8_BATCH_AVX2
+// 0xFF in the bytes whose lane bit is set
+AVX2_FUNCTION static __m256i byteMask(uint32_t lanes)
+{
+	const __m256i spread = _mm256_setr_epi8(
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+		2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+	const __m256i bits = _mm256_set1_epi64x(static_cast<long long>(0x8040201008040201ull));
+	__m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(lanes)), spread);
+	return _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bits), bits);
+}
+
+AVX2_FUNCTION static __m256i loadLanes(const uint8_t* row)
+{
+	return _mm256_load_si256(reinterpret_cast<const __m256i*>(row));
+}
+
+// write value into the lanes in mask, leave the others alone
+AVX2_FUNCTION static void storeLanes(uint8_t* row, __m256i value, __m256i mask)
+{
+	_mm256_store_si256(reinterpret_cast<__m256i*>(row), _mm256_blendv_epi8(loadLanes(row), value, mask));
+}
+
+// 6xkk, 7xkk, 8xy* and Annn for every lane in lanes at once
+// the 8xy5-8xyE handlers set VF before computing Vx from the registers, so these do too:
+// that keeps x or y = F giving the same answer
+AVX2_FUNCTION static void aluAvx2(LaneBlock& block, const Instruction& op, uint32_t lanes)
+{
+	const __m256i one = _mm256_set1_epi8(1);
+	__m256i mask = byteMask(lanes);
+	uint8_t* vx = block.registers[op.x];
+	uint8_t* vy = block.registers[op.y];
+	uint8_t* vf = block.registers[0xF];
+	__m256i x = loadLanes(vx);
+	__m256i y = loadLanes(vy);
+
+	switch (op.kind)
+	{
+	case OpKind::Op6xkk:
+		storeLanes(vx, _mm256_set1_epi8(static_cast<char>(op.kk)), mask);
+		break;
+	case OpKind::Op7xkk:
+		storeLanes(vx, _mm256_add_epi8(x, _mm256_set1_epi8(static_cast<char>(op.kk))), mask);
+		break;
+	case OpKind::Op8xy0:
+		storeLanes(vx, y, mask);
+		break;
+	case OpKind::Op8xy1:
+		storeLanes(vx, _mm256_or_si256(x, y), mask);
+		break;
+	case OpKind::Op8xy2:
+		storeLanes(vx, _mm256_and_si256(x, y), mask);
+		break;
+	case OpKind::Op8xy3:
+		storeLanes(vx, _mm256_xor_si256(x, y), mask);
+		break;
+	case OpKind::Op8xy4:
+	{
+		//carried where the saturating sum differs from the wrapping one
+		__m256i sum = _mm256_add_epi8(x, y);
+		storeLanes(vf, _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_adds_epu8(x, y), sum), one), mask);
+		storeLanes(vx, sum, mask);
+		break;
+	}
+	case OpKind::Op8xy5:
+		//Vx > Vy where min(Vx, Vy) isn't Vx
+		storeLanes(vf, _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(x, y), x), one), mask);
+		storeLanes(vx, _mm256_sub_epi8(loadLanes(vx), loadLanes(vy)), mask);
+		break;
+	case OpKind::Op8xy6:
+		storeLanes(vf, _mm256_and_si256(x, one), mask);
+		storeLanes(vx, _mm256_and_si256(_mm256_srli_epi16(loadLanes(vx), 1), _mm256_set1_epi8(0x7F)), mask);
+		break;
+	case OpKind::Op8xy7:
+		storeLanes(vf, _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(x, y), y), one), mask);
+		storeLanes(vx, _mm256_sub_epi8(loadLanes(vy), loadLanes(vx)), mask);
+		break;
+	case OpKind::Op8xyE:
+		storeLanes(vf, _mm256_and_si256(_mm256_srli_epi16(x, 7), one), mask);
+		x = loadLanes(vx);
+		storeLanes(vx, _mm256_add_epi8(x, x), mask);
+		break;
+	case OpKind::OpAnnn:
+	{
+		//index is 16 bits a lane: two registers, each masked by its half of the lane bits
+		const __m256i bits = _mm256_setr_epi16(0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, 0x80,
+			0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000, static_cast<short>(0x8000));
+		__m256i address = _mm256_set1_epi16(static_cast<short>(op.nnn));
+		for (unsigned int half = 0; half < 2; ++half)
+		{
+			__m256i* row = reinterpret_cast<__m256i*>(block.index + half * 16);
+			__m256i halfMask = _mm256_and_si256(_mm256_set1_epi16(static_cast<short>(lanes >> (half * 16))), bits);
+			halfMask = _mm256_cmpeq_epi16(halfMask, bits);
+			_mm256_store_si256(row, _mm256_blendv_epi8(_mm256_load_si256(row), address, halfMask));
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// 3xkk, 4xkk, 5xy0 and 9xy0: returns the lanes that skip
+AVX2_FUNCTION static uint32_t skipAvx2(LaneBlock& block, const Instruction& op, uint32_t lanes)
+{
+	bool immediate = op.kind == OpKind::Op3xkk || op.kind == OpKind::Op4xkk;
+	__m256i x = loadLanes(block.registers[op.x]);
+	__m256i other = immediate ? _mm256_set1_epi8(static_cast<char>(op.kk)) : loadLanes(block.registers[op.y]);
+	uint32_t equal = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, other)));
+	bool skipIfEqual = op.kind == OpKind::Op3xkk || op.kind == OpKind::Op5xy0;
+	return (skipIfEqual ? equal : ~equal) & lanes;
+}
+#endif
+
+BatchChip8::BatchChip8(unsigned int instances)
+	: instanceCount(instances), blockCount((instances + BATCH_WIDTH - 1) / BATCH_WIDTH),
+	blocks(new LaneBlock[(instances + BATCH_WIDTH - 1) / BATCH_WIDTH]), simd(cpuHasAvx2())
+{
+	//every instance gets its own generator, seeded the way Chip8 seeds its one
+	auto seed = std::chrono::system_clock::now().time_since_epoch().count();
+	for (unsigned int b = 0; b < blockCount; ++b)
+	{
+		for (unsigned int lane = 0; lane < BATCH_WIDTH; ++lane)
+		{
+			blocks[b].randomState[lane] = seed + b * BATCH_WIDTH + lane;
+		}
+	}
+
+	Chip8 image;
+	reset(image.getMemory());
+}
+
+BatchChip8::~BatchChip8() = default;
+
+bool BatchChip8::loadROM(const uint8_t* data, size_t size)
+{
+	//Chip8 lays out the font and ROM, so the batch can't disagree with it
+	Chip8 image;
+	if (!image.loadROM(data, size))
+	{
+		return false;
+	}
+	reset(image.getMemory());
+	return true;
+}
+
+void BatchChip8::reset(const uint8_t* memory)
+{
+	for (unsigned int b = 0; b < blockCount; ++b)
+	{
+		LaneBlock& block = blocks[b];
+		memset(block.registers, 0, sizeof(block.registers));
+		memset(block.index, 0, sizeof(block.index));
+		memset(block.stack, 0, sizeof(block.stack));
+		memset(block.sp, 0, sizeof(block.sp));
+		memset(block.delayTimer, 0, sizeof(block.delayTimer));
+		memset(block.soundTimer, 0, sizeof(block.soundTimer));
+		memset(block.keypad, 0, sizeof(block.keypad));
+		memset(block.video, 0, sizeof(block.video));
+		for (unsigned int lane = 0; lane < BATCH_WIDTH; ++lane)
+		{
+			block.pc[lane] = START_ADDRESS;
+			memcpy(block.memory[lane], memory, MEMORY_SIZE);
+		}
+		block.sharedMemory = true;
+		block.writtenFirst = MEMORY_SIZE;
+		block.writtenLast = 0;
+	}
+}
+
+void BatchChip8::setSimd(bool enabled)
+{
+	simd = enabled && cpuHasAvx2();
+}
+
+bool BatchChip8::simdActive() const
+{
+	return simd;
+}
+
+void BatchChip8::setSeed(unsigned int instance, uint64_t seed)
+{
+	blocks[instance / BATCH_WIDTH].randomState[instance % BATCH_WIDTH] = seed;
+}
+
+void BatchChip8::run(unsigned int count)
+{
+	for (unsigned int b = 0; b < blockCount; ++b)
+	{
+		unsigned int used = instanceCount - b * BATCH_WIDTH;
+		uint32_t lanes = used >= BATCH_WIDTH ? 0xFFFFFFFFu : (1u << used) - 1u;
+		runBlock(blocks[b], lanes, count);
+	}
+}
+
+void BatchChip8::runFrame(unsigned int instructionsPerFrame)
+{
+	run(instructionsPerFrame);
+	tickTimers();
+}
+
+void BatchChip8::tickTimers()
+{
+	for (unsigned int b = 0; b < blockCount; ++b)
+	{
+		LaneBlock& block = blocks[b];
+		for (unsigned int lane = 0; lane < BATCH_WIDTH; ++lane)
+		{
+			block.delayTimer[lane] -= block.delayTimer[lane] > 0;
+			block.soundTimer[lane] -= block.soundTimer[lane] > 0;
+		}
+	}
+}
+
+void BatchChip8::runBlock(LaneBlock& block, uint32_t lanes, unsigned int count)
+{
+	if (count == 0 || lanes == 0)
+	{
+		return;
+	}
+
+	unsigned int remaining[BATCH_WIDTH];
+	uint16_t nextPc[BATCH_WIDTH];
+	Group groups[BATCH_WIDTH];
+	unsigned int groupCount = 0;
+
+	//take a group's steps off its lanes' remaining counts
+	auto settle = [&](Group& group)
+	{
+		for (uint32_t rest = group.lanes; rest; rest &= rest - 1)
+		{
+			remaining[firstLane(rest)] -= group.steps;
+		}
+		group.steps = 0;
+	};
+	auto budget = [&](uint32_t group)
+	{
+		unsigned int least = UINT_MAX;
+		for (uint32_t rest = group; rest; rest &= rest - 1)
+		{
+			unsigned int lane = firstLane(rest);
+			least = remaining[lane] < least ? remaining[lane] : least;
+		}
+		return least;
+	};
+	//settled lanes arriving at pc: finished ones stop there, the rest join the group at pc or start one
+	auto place = [&](uint32_t arriving, uint16_t pc)
+	{
+		for (uint32_t rest = arriving; rest; rest &= rest - 1)
+		{
+			unsigned int lane = firstLane(rest);
+			if (remaining[lane] == 0)
+			{
+				block.pc[lane] = pc;
+				arriving &= ~(1u << lane);
+			}
+		}
+		if (arriving == 0)
+		{
+			return;
+		}
+		for (unsigned int i = 0; i < groupCount; ++i)
+		{
+			if (groups[i].pc == pc)
+			{
+				settle(groups[i]);
+				groups[i].lanes |= arriving;
+				groups[i].budget = budget(groups[i].lanes);
+				return;
+			}
+		}
+		groups[groupCount++] = { arriving, pc, 0, budget(arriving) };
+	};
+
+	//one group per distinct pc; this runs every frame, so it's kept to a pass per group
+	for (uint32_t rest = lanes; rest; rest &= rest - 1)
+	{
+		remaining[firstLane(rest)] = count;
+	}
+	for (uint32_t unplaced = lanes; unplaced != 0;)
+	{
+		uint16_t pc = block.pc[firstLane(unplaced)];
+		uint32_t same = 0;
+		for (uint32_t rest = unplaced; rest; rest &= rest - 1)
+		{
+			unsigned int lane = firstLane(rest);
+			same |= block.pc[lane] == pc ? 1u << lane : 0;
+		}
+		unplaced &= ~same;
+		groups[groupCount++] = { same, pc, 0, count };
+	}
+
+	while (groupCount > 0)
+	{
+		//lowest pc first: lanes that branched ahead wait there for the others to catch up
+		unsigned int current = 0;
+		for (unsigned int i = 1; i < groupCount; ++i)
+		{
+			if (groups[i].pc < groups[current].pc)
+			{
+				current = i;
+			}
+		}
+		Group& group = groups[current];
+		uint16_t pc = group.pc & ADDRESS_MASK;
+		uint16_t opcode = fetch(block, firstLane(group.lanes), pc);
+
+		//once the lanes' memory differs, so can the instruction at pc
+		bool sameOpcode = true;
+		if (!block.sharedMemory)
+		{
+			for (uint32_t rest = group.lanes; rest && sameOpcode; rest &= rest - 1)
+			{
+				sameOpcode = fetch(block, firstLane(rest), pc) == opcode;
+			}
+		}
+
+		++groupSteps;
+		laneSteps += std::bitset<BATCH_WIDTH>(group.lanes).count();
+
+		Instruction op = decode(opcode);
+		uint16_t next = pc + 2;
+		uint32_t skipped = 0;
+		bool perLane = false;
+#ifdef CHIP8_BATCH_AVX2
+		if (simd && sameOpcode && isVectorAlu(op.kind))
+		{
+			aluAvx2(block, op, group.lanes);
+		}
+		else if (simd && sameOpcode && isVectorSkip(op.kind))
+		{
+			skipped = skipAvx2(block, op, group.lanes);
+		}
+		else
+#endif
+		if (sameOpcode && op.kind == OpKind::Op1nnn)
+		{
+			next = op.nnn;
+		}
+		else
+		{
+			uint16_t common = 0;
+			for (uint32_t rest = group.lanes; rest; rest &= rest - 1)
+			{
+				unsigned int lane = firstLane(rest);
+				nextPc[lane] = stepLane(block, lane, sameOpcode ? op : decode(fetch(block, lane, pc)), pc);
+				perLane |= rest != group.lanes && nextPc[lane] != common;
+				common = nextPc[lane];
+			}
+			checkWritten(block);
+			next = common;
+		}
+		++group.steps;
+
+		if (!perLane && (skipped == 0 || skipped == group.lanes))
+		{
+			//the whole group moves on together
+			group.pc = skipped ? next + 2 : next;
+			if (group.steps == group.budget)
+			{
+				Group done = group;
+				groups[current] = groups[--groupCount];
+				settle(done);
+				place(done.lanes, done.pc);
+				continue;
+			}
+			for (unsigned int i = 0; i < groupCount; ++i)
+			{
+				if (i != current && groups[i].pc == group.pc)
+				{
+					settle(groups[i]);
+					settle(group);
+					groups[i].lanes |= group.lanes;
+					groups[i].budget = budget(groups[i].lanes);
+					groups[current] = groups[--groupCount];
+					break;
+				}
+			}
+			continue;
+		}
+
+		//the group comes apart: every lane goes to the group at its new pc
+		Group split = group;
+		groups[current] = groups[--groupCount];
+		settle(split);
+		if (perLane)
+		{
+			for (uint32_t rest = split.lanes; rest; rest &= rest - 1)
+			{
+				unsigned int lane = firstLane(rest);
+				place(1u << lane, nextPc[lane]);
+			}
+		}
+		else
+		{
+			place(split.lanes & skipped, next + 2);
+			place(split.lanes & ~skipped, next);
+		}
+	}
+}
+
+unsigned int BatchChip8::size() const
+{
+	return instanceCount;
+}
+
+uint8_t* BatchChip8::getKeypad(unsigned int instance)
+{
+	return blocks[instance / BATCH_WIDTH].keypad[instance % BATCH_WIDTH];
+}
+
+const uint8_t* BatchChip8::getVideo(unsigned int instance)
+{
+	return blocks[instance / BATCH_WIDTH].video[instance % BATCH_WIDTH];
+}
+
+const uint8_t* BatchChip8::getMemory(unsigned int instance)
+{
+	return blocks[instance / BATCH_WIDTH].memory[instance % BATCH_WIDTH];
+}
+
+uint8_t BatchChip8::getRegister(unsigned int instance, unsigned int r)
+{
+	return blocks[instance / BATCH_WIDTH].registers[r][instance % BATCH_WIDTH];
+}
+
+uint16_t BatchChip8::getStack(unsigned int instance, unsigned int level)
+{
+	return blocks[instance / BATCH_WIDTH].stack[level][instance % BATCH_WIDTH];
+}
+
+uint16_t BatchChip8::getProgramCounter(unsigned int instance)
+{
+	return blocks[instance / BATCH_WIDTH].pc[instance % BATCH_WIDTH];
+}
+
+uint16_t BatchChip8::getIndex(unsigned int instance)
+{
+	return blocks[instance / BATCH_WIDTH].index[instance % BATCH_WIDTH];
+}
+
+uint8_t BatchChip8::getStackPointer(unsigned int instance)
+{
+	return blocks[instance / BATCH_WIDTH].sp[instance % BATCH_WIDTH];
+}
+
+uint8_t BatchChip8::getDelayTimer(unsigned int instance)
+{
+	return blocks[instance / BATCH_WIDTH].delayTimer[instance % BATCH_WIDTH];
+}
+
+uint8_t BatchChip8::getSoundTimer(unsigned int instance)
+{
+	return blocks[instance / BATCH_WIDTH].soundTimer[instance % BATCH_WIDTH];
+}
+
+uint64_t BatchChip8::getLaneSteps() const
+{
+	return laneSteps;
+}
+
+uint64_t BatchChip8::getGroupSteps() const
+{
+	return groupSteps;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Chip8.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+struct LaneBlock;
+
+const unsigned int BATCH_WIDTH = 32;	//instances per lane block, one AVX2 register of bytes
+
+/*
+	Runs many instances of the same ROM side by side, for fuzzing and search where only the input
+	differs between them.
+
+	Instances are kept in blocks of BATCH_WIDTH, and inside a block the registers, index, pc, stack
+	and timers are stored structure-of-arrays: registers[r][lane], so one register of every instance
+	is one contiguous row. Instances at the same pc run as a group, one instruction for the whole
+	group at a time. The ALU instructions (6xkk, 7xkk, 8xy*, Annn) and the skips (3xkk, 4xkk, 5xy0,
+	9xy0) run as AVX2 operations on those rows when the CPU has it; everything else runs lane by
+	lane. A group splits when its instances end up at different pcs and merges back into any group
+	it meets, always running the group with the lowest pc first so branches get the chance to rejoin.
+
+	Memory and video are kept per instance, and so is the random generator. Results match the scalar
+	Chip8 exactly when each instance is seeded the same as its scalar run (setSeed).
+*/
+
+class BatchChip8
+{
+public:
+	explicit BatchChip8(unsigned int instances);
+	~BatchChip8();
+
+	//load the same ROM into every instance and reset them all; false if it doesn't fit
+	bool loadROM(const uint8_t* data, size_t size);
+
+	//the AVX2 kernels are used when the CPU supports them; false forces lane by lane everywhere
+	void setSimd(bool enabled);
+	bool simdActive() const;
+
+	//seed one instance's random generator, same as Chip8::setSeed
+	void setSeed(unsigned int instance, uint64_t seed);
+
+	//run count instructions on every instance
+	void run(unsigned int count);
+
+	//one 60 Hz frame on every instance, same as Chip8::runFrame
+	void runFrame(unsigned int instructionsPerFrame);
+
+	void tickTimers();
+
+	unsigned int size() const;
+
+	uint8_t* getKeypad(unsigned int instance);
+	const uint8_t* getVideo(unsigned int instance);
+	const uint8_t* getMemory(unsigned int instance);
+	uint8_t getRegister(unsigned int instance, unsigned int r);
+	uint16_t getStack(unsigned int instance, unsigned int level);
+	uint16_t getProgramCounter(unsigned int instance);
+	uint16_t getIndex(unsigned int instance);
+	uint8_t getStackPointer(unsigned int instance);
+	uint8_t getDelayTimer(unsigned int instance);
+	uint8_t getSoundTimer(unsigned int instance);
+
+	//instructions executed summed over instances, and group steps that executed them;
+	//their ratio is how many instances ran in lockstep on average
+	uint64_t getLaneSteps() const;
+	uint64_t getGroupSteps() const;
+
+private:
+	unsigned int instanceCount;
+	unsigned int blockCount;
+	std::unique_ptr<LaneBlock[]> blocks;
+	bool simd;
+	uint64_t laneSteps = 0;
+	uint64_t groupSteps = 0;
+
+	//every instance back to power-on with memory as its memory image
+	void reset(const uint8_t* memory);
+	void runBlock(LaneBlock& block, uint32_t lanes, unsigned int count);
+};
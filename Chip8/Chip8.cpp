@@ -1,16 +1,22 @@
 #include "Chip8.h"
+#include "Jit.h"
+#include "MappedFile.h"
+#ifdef CHIP8_PROFILE
+#include "Profiler.h"
+#endif
+#include "Random.h"
+#include "SaveState.h"
+#include "Semantics.h"
 #include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
-#include <fstream>
-#include <random>
-#include <SFML/Graphics.hpp>
-#include <iomanip>
 
 const unsigned int FONTSET_SIZE = 80;
-const unsigned int FONTSET_START_ADDRESS = 0x50;
-const unsigned int START_ADDRESS = 0x200;
+
+//registers and stack one after another, for the helpers in Semantics.h
+typedef Strided<uint8_t, 1> RegisterFile;
+typedef Strided<uint16_t, 1> StackFile;
 
 uint8_t fontset[80] = 
 	{
@@ -32,94 +38,660 @@ uint8_t fontset[80] =
 			0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 	};
 
-Chip8::Chip8() : randGen(std::chrono::system_clock::now().time_since_epoch().count())
+//indexed by OpKind, in the same order as the enum in Decoder.h
+const Chip8::OpRef Chip8::handlers[OP_KIND_COUNT] =
+{
+	&Chip8::OP_NULL,
+	&Chip8::OP_00E0,
+	&Chip8::OP_00EE,
+	&Chip8::OP_1nnn,
+	&Chip8::OP_2nnn,
+	&Chip8::OP_3xkk,
+	&Chip8::OP_4xkk,
+	&Chip8::OP_5xy0,
+	&Chip8::OP_6xkk,
+	&Chip8::OP_7xkk,
+	&Chip8::OP_8xy0,
+	&Chip8::OP_8xy1,
+	&Chip8::OP_8xy2,
+	&Chip8::OP_8xy3,
+	&Chip8::OP_8xy4,
+	&Chip8::OP_8xy5,
+	&Chip8::OP_8xy6,
+	&Chip8::OP_8xy7,
+	&Chip8::OP_8xyE,
+	&Chip8::OP_9xy0,
+	&Chip8::OP_Annn,
+	&Chip8::OP_Bnnn,
+	&Chip8::OP_Cxkk,
+	&Chip8::OP_Dxyn,
+	&Chip8::OP_Ex9E,
+	&Chip8::OP_ExA1,
+	&Chip8::OP_Fx07,
+	&Chip8::OP_Fx0A,
+	&Chip8::OP_Fx15,
+	&Chip8::OP_Fx18,
+	&Chip8::OP_Fx1E,
+	&Chip8::OP_Fx29,
+	&Chip8::OP_Fx33,
+	&Chip8::OP_Fx55,
+	&Chip8::OP_Fx65
+};
+
+Chip8::Chip8() : randomState(std::chrono::system_clock::now().time_since_epoch().count())
 {
 	pc = 0x200;
-	randByte = std::uniform_int_distribution<>(0, 225U);
 
 	for (unsigned int i = 0; i < FONTSET_SIZE; ++i)
 	{
 		memory[FONTSET_START_ADDRESS + i] = fontset[i];
 	}
+}
 
-	table[0x0] = &Chip8::Table0;
-	table[0x1] = &Chip8::OP_1nnn;
-	table[0x2] = &Chip8::OP_2nnn;
-	table[0x3] = &Chip8::OP_3xkk;
-	table[0x4] = &Chip8::OP_4xkk;
-	table[0x5] = &Chip8::OP_5xy0;
-	table[0x6] = &Chip8::OP_6xkk;
-	table[0x7] = &Chip8::OP_7xkk;
-	table[0x8] = &Chip8::Table8;
-	table[0x9] = &Chip8::OP_9xy0;
-	table[0xA] = &Chip8::OP_Annn;
-	table[0xB] = &Chip8::OP_Bnnn;
-	table[0xC] = &Chip8::OP_Cxkk;
-	table[0xD] = &Chip8::OP_Dxyn;
-	table[0xE] = &Chip8::TableE;
-	table[0xF] = &Chip8::TableF;
-	table0[0x0] = &Chip8::OP_00E0;
-	table0[0xE] = &Chip8::OP_00EE;
-	table8[0x0] = &Chip8::OP_8xy0;
-	table8[0x1] = &Chip8::OP_8xy1;
-	table8[0x2] = &Chip8::OP_8xy2;
-	table8[0x3] = &Chip8::OP_8xy3;
-	table8[0x4] = &Chip8::OP_8xy4;
-	table8[0x5] = &Chip8::OP_8xy5;
-	table8[0x6] = &Chip8::OP_8xy6;
-	table8[0x7] = &Chip8::OP_8xy7;
-	table8[0xE] = &Chip8::OP_8xyE;
-	tableE[0x1] = &Chip8::OP_ExA1;
-	tableE[0xE] = &Chip8::OP_Ex9E;
-	tableF[0x07] = &Chip8::OP_Fx07;
-	tableF[0x0A] = &Chip8::OP_Fx0A;
-	tableF[0x15] = &Chip8::OP_Fx15;
-	tableF[0x18] = &Chip8::OP_Fx18;
-	tableF[0x1E] = &Chip8::OP_Fx1E;
-	tableF[0x29] = &Chip8::OP_Fx29;
-	tableF[0x33] = &Chip8::OP_Fx33;
-	tableF[0x55] = &Chip8::OP_Fx55;
-	tableF[0x65] = &Chip8::OP_Fx65;
-}
-
-void Chip8::loadROM(std::string file) 
+Chip8::~Chip8() = default;
+
+bool Chip8::loadROM(std::string file)
 {
 	std::cout << "Reading..." << std::endl;
-	// open binary stream from end
-	std::ifstream rom(file, std::ios::binary | std::ios::ate);
+	//mapped straight from the page cache into memory, no buffer in between
+	MappedFile rom;
+	if (!rom.open(file))
+	{
+		std::cerr << "Could not open file." << std::endl;
+		return false;
+	}
+	if (!loadROM(rom.data(), rom.size()))
+	{
+		std::cerr << "ROM is too large: " << rom.size() << " bytes, at most " << MEMORY_SIZE - START_ADDRESS
+			<< " fit." << std::endl;
+		return false;
+	}
+	std::cout << "Loaded ROM into memory..." << std::endl;
+	return true;
+}
+
+bool Chip8::loadROM(const uint8_t* data, size_t size)
+{
+	if (size > MEMORY_SIZE - START_ADDRESS)
+	{
+		return false;
+	}
+	//an empty ROM loads as an empty program (and data may be nullptr)
+	if (size > 0)
+	{
+		memcpy(memory + START_ADDRESS, data, size);
+	}
+	invalidateCode(START_ADDRESS, static_cast<unsigned int>(size));
+
+	if (!pristine)
+	{
+		pristine = std::make_unique<SaveState>();
+	}
+	saveState(*pristine);
+	changedFirst = changedLast = 0;
+	return true;
+}
 
-	if (rom.is_open())
+bool Chip8::reset()
+{
+	if (!pristine)
 	{
-		std::streampos size = rom.tellg(); //get size from position, which will be at the end
-		char* buffer = new char[size]; //initialize buffer using size
+		return false;
+	}
+	restoreState(*pristine, changedFirst, changedLast);
+	changedFirst = changedLast = 0;
+	return true;
+}
+
+void Chip8::setSeed(uint64_t seed)
+{
+	randomState = seed;
+}
 
-		rom.seekg(0, std::ios::beg);
-		rom.read(buffer, size);
-		rom.close();
+#ifdef CHIP8_PROFILE
+void Chip8::setProfiler(Profiler* p)
+{
+	profiler = p;
+}
+#endif
+
+void Chip8::setEngine(Engine e)
+{
+	engine = e;
+	if (engine == Engine::Jit && !jit)
+	{
+		jit = std::make_unique<Jit>(*this);
+	}
+	if (engine == Engine::Jit && !jit->isAvailable())
+	{
+		std::cerr << "JIT unavailable, using the cached interpreter." << std::endl;
+		engine = Engine::Cached;
+	}
+	if ((engine == Engine::Cached || engine == Engine::Jit) && !decodeCache)
+	{
+		//value-initialized, so every entry starts out undecoded
+		decodeCache = std::make_unique<DecodedOp[]>(MEMORY_SIZE);
+	}
+}
 
-		for (long i = 0; i < size; ++i)
+void Chip8::cycle()
+{
+#ifdef CHIP8_PROFILE
+	if (profiler)
+	{
+		runProfiled(1);
+		return;
+	}
+#endif
+	//single steps are interpreted even under the JIT, since blocks can't stop part way
+	if (engine == Engine::Table)
+	{
+		cycleTable();
+	}
+	else if (engine == Engine::Switch)
+	{
+		runSwitch(1);
+	}
+	else
+	{
+		cycleCached();
+	}
+}
+
+void Chip8::run(unsigned int count)
+{
+#ifdef CHIP8_PROFILE
+	if (profiler)
+	{
+		runProfiled(count);
+		return;
+	}
+#endif
+	//pick the engine once, not per instruction
+	if (engine == Engine::Jit)
+	{
+		unsigned int i = 0;
+		while (i < count)
 		{
-			memory[START_ADDRESS + i] = buffer[i]; //load to memory
+			uint16_t address = pc;
+			unsigned int executed = jit->execute(count - i);
+			if (executed == 0)
+			{
+				cycleCached();
+				executed = 1;
+			}
+			i += executed;
+			if (pc <= address)
+			{
+				i += skipIdle(count - i);
+			}
 		}
-		std::cout << "Loaded ROM into memory..." << std::endl;
-		delete[] buffer; buffer = nullptr;
-	} 
+	}
+	else if (engine == Engine::Cached)
+	{
+		runCached(count);
+	}
+	else if (engine == Engine::Switch)
+	{
+		runSwitch(count);
+	}
 	else
 	{
-		std::cerr << "Could not open file." << std::endl;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			uint16_t address = pc;
+			cycleTable();
+			if (pc <= address)
+			{
+				i += skipIdle(count - i - 1);
+			}
+		}
 	}
+}
 
+// The loops a program waits in, when nothing inside run() can end them: keys and timers only change
+// between runs. Those are a jump to itself, a skip that isn't taken followed by a jump back to it,
+// the delay timer poll (Fx07, such a skip, a jump back) once Vx already holds the timer, and Fx0A
+// with no key down. None of them change anything but pc, so the rest of the budget is skipped to
+// where the loop would be when it ran out, and the next timer tick or key change comes straight away.
+unsigned int Chip8::skipIdle(unsigned int remaining)
+{
+	if (remaining == 0)
+	{
+		return 0;
+	}
+
+	uint16_t start = pc;
+	Instruction first = instructionAt(start);
+	unsigned int length = 0;
+	if (first.kind == OpKind::Op1nnn)
+	{
+		length = first.nnn == start ? 1 : 0;
+	}
+	else if (isSkip(first.kind))
+	{
+		Instruction jump = instructionAt(start + 2);
+		length = !skipTaken(first) && jump.kind == OpKind::Op1nnn && jump.nnn == start ? 2 : 0;
+	}
+	else if (first.kind == OpKind::OpFx0A && !anyKeyDown())
+	{
+		length = 1;
+		keyWait = true;
+	}
+	else if (first.kind == OpKind::OpFx07 && registers[first.x] == delayTimer)
+	{
+		Instruction skip = instructionAt(start + 2);
+		Instruction jump = instructionAt(start + 4);
+		length = isSkip(skip.kind) && !skipTaken(skip) && jump.kind == OpKind::Op1nnn && jump.nnn == start ? 3 : 0;
+	}
+	if (length == 0)
+	{
+		return 0;
+	}
+
+	//stop where running remaining more instructions of the loop would have
+	unsigned int position = remaining % length;
+	unsigned int last = start + 2 * ((position + length - 1) % length);
+	opcode = (memory[last] << 8u) | memory[last + 1];
+	op = decode(opcode);
+	pc = static_cast<uint16_t>(start + 2 * position);
+	elidedInstructions += remaining;
+	return remaining;
 }
 
-void Chip8::cycle()
+// what the skip's handler would decide, without running it
+bool Chip8::skipTaken(const Instruction& skip)
+{
+	return ::skipTaken(skip, RegisterFile{ registers }, keypad);
+}
+
+// Null past the end of memory
+Instruction Chip8::instructionAt(unsigned int address)
+{
+	return address + 1 < MEMORY_SIZE ? decode((memory[address] << 8u) | memory[address + 1]) : Instruction{};
+}
+
+void Chip8::cycleTable()
 {
 	//opcodes are split across two memory addresses
-	opcode = (memory[pc] << 8u) | memory[pc + 1];
+	pc &= ADDRESS_MASK;
+	opcode = (memory[pc] << 8u) | memory[(pc + 1) & ADDRESS_MASK];
+	op = decode(opcode);
+
+	pc += 2;
+
+	((*this).*(handlers[static_cast<size_t>(op.kind)]))();
+}
+
+void Chip8::cycleCached()
+{
+	pc &= ADDRESS_MASK;
+	DecodedOp& decoded = decodeAt(pc);
+
+	opcode = decoded.opcode;
+	op = decoded.instruction;
 
 	pc += 2;
 
-	((*this).*(table[(opcode & 0xF000u) >> 12u]))(); // get first hex digit of opcode to reference table
-	
+	((*this).*(decoded.handler))();
+}
+
+// the cached engine's loop: a fusion runs as one step when the budget has room for all of it,
+// so a run still stops after exactly count instructions
+void Chip8::runCached(unsigned int count)
+{
+	unsigned int i = 0;
+	while (i < count)
+	{
+		uint16_t address = pc;
+		pc &= ADDRESS_MASK;
+		DecodedOp& decoded = decodeAt(pc);
+		if (decoded.fusion != Fusion::None && count - i >= fusionLength(decoded.fusion))
+		{
+			++fusionCounts[static_cast<size_t>(decoded.fusion)];
+			i += runFused(decoded);
+		}
+		else
+		{
+			opcode = decoded.opcode;
+			op = decoded.instruction;
+
+			pc += 2;
+
+			((*this).*(decoded.handler))();
+			++i;
+		}
+		if (pc <= address)
+		{
+			i += skipIdle(count - i);
+		}
+	}
+}
+
+// the cache entry for address (already masked), decoding it and the fusion it starts first if it isn't there yet
+Chip8::DecodedOp& Chip8::decodeAt(unsigned int address)
+{
+	DecodedOp& decoded = decodeCache[address];
+	if (!decoded.handler)
+	{
+		decoded.opcode = (memory[address] << 8u) | memory[(address + 1) & ADDRESS_MASK];
+		decoded.instruction = decode(decoded.opcode);
+		decoded.handler = handlers[static_cast<size_t>(decoded.instruction.kind)];
+
+		//the instructions after it; Null where they'd run off the end of memory, so no fusion wraps
+		Instruction next[MAX_FUSED_INSTRUCTIONS - 1]{};
+		for (unsigned int i = 0; i < MAX_FUSED_INSTRUCTIONS - 1; ++i)
+		{
+			unsigned int at = address + 2 * (i + 1);
+			if (at + 1 < MEMORY_SIZE)
+			{
+				next[i] = decode((memory[at] << 8u) | memory[at + 1]);
+			}
+		}
+		decoded.fusion = classifyFusion(decoded.instruction, next[0], next[1]);
+	}
+	return decoded;
+}
+
+// One superinstruction (see Fusion in Decoder.h), starting at pc. Each leaves pc, opcode and op
+// where its last instruction to run would have; skips go through their handlers, so a taken skip
+// ends the fusion early. Returns how many instructions ran.
+unsigned int Chip8::runFused(const DecodedOp& decoded)
+{
+	unsigned int address = pc;
+	switch (decoded.fusion)
+	{
+	case Fusion::Load2:
+	case Fusion::Load3:
+	{
+		unsigned int length = decoded.fusion == Fusion::Load3 ? 3 : 2;
+		const DecodedOp* last = &decoded;
+		for (unsigned int i = 0; i < length; ++i)
+		{
+			last = i == 0 ? &decoded : &decodeAt(address + 2 * i);
+			registers[last->instruction.x] = last->instruction.kk;
+		}
+		opcode = last->opcode;
+		op = last->instruction;
+		pc = static_cast<uint16_t>(address + 2 * length);
+		return length;
+	}
+	case Fusion::IndexDraw:
+	{
+		const DecodedOp& draw = decodeAt(address + 2);
+		index = decoded.instruction.nnn;
+		opcode = draw.opcode;
+		op = draw.instruction;
+		pc = static_cast<uint16_t>(address + 4);
+		OP_Dxyn();
+		return 2;
+	}
+	case Fusion::TimerPoll:
+	case Fusion::SkipJump:
+	{
+		unsigned int executed = 0;
+		const DecodedOp* skip = &decoded;
+		if (decoded.fusion == Fusion::TimerPoll)
+		{
+			registers[decoded.instruction.x] = delayTimer;
+			skip = &decodeAt(address + 2);
+			address += 2;
+			executed = 1;
+		}
+		opcode = skip->opcode;
+		op = skip->instruction;
+		pc = static_cast<uint16_t>(address + 2);
+		((*this).*(skip->handler))();
+		if (pc != address + 2)
+		{
+			return executed + 1;	//skipped the jump
+		}
+		const DecodedOp& jump = decodeAt(address + 2);
+		opcode = jump.opcode;
+		op = jump.instruction;
+		pc = jump.instruction.nnn;
+		return executed + 2;
+	}
+	default:
+		return 0;
+	}
+}
+
+#ifdef CHIP8_PROFILE
+// The table interpreter with a count per instruction and a clock around the expensive handlers.
+// Compiled JIT blocks and threaded dispatch can't be counted per instruction, so every engine
+// comes here while a profiler is attached; the handlers are the same, so the results are too.
+void Chip8::runProfiled(unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		pc &= ADDRESS_MASK;
+		opcode = (memory[pc] << 8u) | memory[(pc + 1) & ADDRESS_MASK];
+		op = decode(opcode);
+		profiler->count(pc, op.kind);
+
+		pc += 2;
+
+		OpRef handler = handlers[static_cast<size_t>(op.kind)];
+		if (Profiler::isTimed(op.kind))
+		{
+			auto start = std::chrono::steady_clock::now();
+			((*this).*handler)();
+			profiler->addTime(op.kind, std::chrono::steady_clock::now() - start);
+		}
+		else
+		{
+			((*this).*handler)();
+		}
+	}
+}
+#endif
+
+// Same handlers as the table, but every one is a direct call from one function, so the compiler
+// inlines them and there are no pointer-to-member hops. With GCC/Clang each handler ends in its
+// own indirect jump to the next one (direct threading), which gives the branch predictor one
+// history per instruction kind instead of a single shared dispatch branch.
+#if defined(__GNUC__)
+#define CHIP8_THREADED 1
+#else
+#define CHIP8_THREADED 0
+#endif
+
+void Chip8::runSwitch(unsigned int count)
+{
+#define FETCH() \
+	pc &= ADDRESS_MASK; \
+	opcode = (memory[pc] << 8u) | memory[(pc + 1) & ADDRESS_MASK]; \
+	op = decode(opcode); \
+	pc += 2
+
+#if CHIP8_THREADED
+	//same order as OpKind
+	static void* const labels[OP_KIND_COUNT] = {
+		&&Null, &&Op00E0, &&Op00EE, &&Op1nnn, &&Op2nnn, &&Op3xkk, &&Op4xkk, &&Op5xy0, &&Op6xkk,
+		&&Op7xkk, &&Op8xy0, &&Op8xy1, &&Op8xy2, &&Op8xy3, &&Op8xy4, &&Op8xy5, &&Op8xy6, &&Op8xy7,
+		&&Op8xyE, &&Op9xy0, &&OpAnnn, &&OpBnnn, &&OpCxkk, &&OpDxyn, &&OpEx9E, &&OpExA1, &&OpFx07,
+		&&OpFx0A, &&OpFx15, &&OpFx18, &&OpFx1E, &&OpFx29, &&OpFx33, &&OpFx55, &&OpFx65
+	};
+#define KIND(k) k:
+#define NEXT() \
+	if (--count == 0) return; \
+	FETCH(); \
+	goto *labels[static_cast<size_t>(op.kind)]
+
+	if (count == 0)
+	{
+		return;
+	}
+	FETCH();
+	goto *labels[static_cast<size_t>(op.kind)];
+#else
+#define KIND(k) case OpKind::k:
+#define NEXT() break
+
+	for (; count > 0; --count)
+	{
+		FETCH();
+		switch (op.kind)
+		{
+#endif
+
+	KIND(Null)
+		NEXT();
+	KIND(Op00E0)
+		OP_00E0();
+		NEXT();
+	KIND(Op00EE)
+		OP_00EE();
+		NEXT();
+	KIND(Op1nnn)
+		OP_1nnn();
+		count -= skipIdle(count - 1);
+		NEXT();
+	KIND(Op2nnn)
+		OP_2nnn();
+		NEXT();
+	KIND(Op3xkk)
+		OP_3xkk();
+		NEXT();
+	KIND(Op4xkk)
+		OP_4xkk();
+		NEXT();
+	KIND(Op5xy0)
+		OP_5xy0();
+		NEXT();
+	KIND(Op6xkk)
+		OP_6xkk();
+		NEXT();
+	KIND(Op7xkk)
+		OP_7xkk();
+		NEXT();
+	KIND(Op8xy0)
+		OP_8xy0();
+		NEXT();
+	KIND(Op8xy1)
+		OP_8xy1();
+		NEXT();
+	KIND(Op8xy2)
+		OP_8xy2();
+		NEXT();
+	KIND(Op8xy3)
+		OP_8xy3();
+		NEXT();
+	KIND(Op8xy4)
+		OP_8xy4();
+		NEXT();
+	KIND(Op8xy5)
+		OP_8xy5();
+		NEXT();
+	KIND(Op8xy6)
+		OP_8xy6();
+		NEXT();
+	KIND(Op8xy7)
+		OP_8xy7();
+		NEXT();
+	KIND(Op8xyE)
+		OP_8xyE();
+		NEXT();
+	KIND(Op9xy0)
+		OP_9xy0();
+		NEXT();
+	KIND(OpAnnn)
+		OP_Annn();
+		NEXT();
+	KIND(OpBnnn)
+		OP_Bnnn();
+		NEXT();
+	KIND(OpCxkk)
+		OP_Cxkk();
+		NEXT();
+	KIND(OpDxyn)
+		OP_Dxyn();
+		NEXT();
+	KIND(OpEx9E)
+		OP_Ex9E();
+		NEXT();
+	KIND(OpExA1)
+		OP_ExA1();
+		NEXT();
+	KIND(OpFx07)
+		OP_Fx07();
+		NEXT();
+	KIND(OpFx0A)
+		OP_Fx0A();
+		count -= skipIdle(count - 1);
+		NEXT();
+	KIND(OpFx15)
+		OP_Fx15();
+		NEXT();
+	KIND(OpFx18)
+		OP_Fx18();
+		NEXT();
+	KIND(OpFx1E)
+		OP_Fx1E();
+		NEXT();
+	KIND(OpFx29)
+		OP_Fx29();
+		NEXT();
+	KIND(OpFx33)
+		OP_Fx33();
+		NEXT();
+	KIND(OpFx55)
+		OP_Fx55();
+		NEXT();
+	KIND(OpFx65)
+		OP_Fx65();
+		NEXT();
+
+#if !CHIP8_THREADED
+		default:
+			NEXT();
+		}
+	}
+#endif
+
+#undef FETCH
+#undef KIND
+#undef NEXT
+}
+
+void Chip8::runFrame(unsigned int instructionsPerFrame)
+{
+	//blocked on Fx0A, the whole frame would be Fx0A finding no key again; only the timers move
+	bool blocked = waitingForKey();
+#ifdef CHIP8_PROFILE
+	blocked = blocked && !profiler;
+#endif
+	if (blocked)
+	{
+		elidedInstructions += instructionsPerFrame;
+	}
+	else
+	{
+		run(instructionsPerFrame);
+	}
+	tickTimers();
+}
+
+bool Chip8::waitingForKey()
+{
+	return keyWait && !anyKeyDown();
+}
+
+bool Chip8::anyKeyDown()
+{
+	for (unsigned int i = 0; i < KEY_COUNT; ++i)
+	{
+		if (keypad[i])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void Chip8::tickTimers()
+{
 	if (delayTimer > 0)
 	{
 		--delayTimer;
@@ -130,6 +702,126 @@ void Chip8::cycle()
 	}
 }
 
+void Chip8::invalidateCode(unsigned int address, unsigned int length)
+{
+	unsigned int end = address + length < MEMORY_SIZE ? address + length : MEMORY_SIZE;
+	if (address < end && writtenFirst >= writtenLast)
+	{
+		writtenFirst = address;
+		writtenLast = end;
+	}
+	else if (address < end)
+	{
+		writtenFirst = address < writtenFirst ? address : writtenFirst;
+		writtenLast = end > writtenLast ? end : writtenLast;
+	}
+	if (address < end && changedFirst >= changedLast)
+	{
+		changedFirst = address;
+		changedLast = end;
+	}
+	else if (address < end)
+	{
+		changedFirst = address < changedFirst ? address : changedFirst;
+		changedLast = end > changedLast ? end : changedLast;
+	}
+
+	if (jit)
+	{
+		jit->invalidate(address, length);
+	}
+	if (!decodeCache)
+	{
+		return;
+	}
+	//an instruction at address - 1 reads its second byte from address, and a fusion further back
+	//reads the instructions after its own
+	unsigned int reach = 2 * MAX_FUSED_INSTRUCTIONS - 1;
+	unsigned int first = address > reach ? address - reach : 0;
+	unsigned int last = address + length < MEMORY_SIZE ? address + length : MEMORY_SIZE;
+	for (unsigned int i = first; i < last; ++i)
+	{
+		decodeCache[i].handler = nullptr;
+	}
+	//and the instruction at the last address reads its second byte from 0
+	if (address == 0 && length > 0)
+	{
+		decodeCache[ADDRESS_MASK].handler = nullptr;
+	}
+}
+
+void Chip8::setPackedVideo(bool packed)
+{
+	if (packed == packedVideo)
+	{
+		return;
+	}
+	if (packed)
+	{
+		packVideo();
+	}
+	else
+	{
+		expandVideo();
+	}
+	packedVideo = packed;
+}
+
+const uint8_t* Chip8::getVideo()
+{
+	if (packedVideo && !videoExpanded)
+	{
+		expandVideo();
+	}
+	return video;
+}
+
+uint32_t Chip8::takeDirtyRows()
+{
+	uint32_t rows = dirtyRows;
+	dirtyRows = 0;
+	return rows;
+}
+
+bool Chip8::takeWrittenMemory(unsigned int& first, unsigned int& last)
+{
+	if (writtenFirst >= writtenLast)
+	{
+		return false;
+	}
+	first = writtenFirst;
+	last = writtenLast;
+	writtenFirst = writtenLast = 0;
+	return true;
+}
+
+void Chip8::packVideo()
+{
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+	{
+		uint64_t row = 0;
+		for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+		{
+			row = (row << 1u) | (video[y * VIDEO_WIDTH + x] ? 1u : 0u);
+		}
+		videoRows[y] = row;
+	}
+	videoExpanded = true;
+}
+
+void Chip8::expandVideo()
+{
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+	{
+		uint64_t row = videoRows[y];
+		for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+		{
+			video[y * VIDEO_WIDTH + x] = (row >> (VIDEO_WIDTH - 1 - x)) & 1u ? 0xFF : 0x00;
+		}
+	}
+	videoExpanded = true;
+}
+
 uint16_t Chip8::getOpcode()
 {
 	return opcode;
@@ -166,6 +858,95 @@ uint16_t* Chip8::getStack()
 	return stack;
 }
 
+const uint8_t* Chip8::getMemory()
+{
+	return memory;
+}
+
+const uint64_t* Chip8::getFusionCounts()
+{
+	return fusionCounts;
+}
+
+uint64_t Chip8::getElidedInstructions()
+{
+	return elidedInstructions;
+}
+
+void Chip8::saveState(SaveState& state)
+{
+	//zero first so reserved bytes are too, and equal machines give equal files
+	memset(&state, 0, sizeof(state));
+	memcpy(state.magic, SAVE_STATE_MAGIC, sizeof(state.magic));
+	state.version = SAVE_STATE_VERSION;
+	state.size = sizeof(SaveState);
+	state.randomState = randomState;
+
+	memcpy(state.stack, stack, sizeof(state.stack));
+	state.pc = pc;
+	state.index = index;
+	state.opcode = opcode;
+	state.sp = sp;
+	state.delayTimer = delayTimer;
+	state.soundTimer = soundTimer;
+	memcpy(state.registers, registers, sizeof(state.registers));
+	memcpy(state.keypad, keypad, sizeof(state.keypad));
+	memcpy(state.memory, memory, sizeof(state.memory));
+	memcpy(state.video, getVideo(), sizeof(state.video));
+}
+
+bool Chip8::loadState(const SaveState& state)
+{
+	if (!isSaveState(state))
+	{
+		return false;
+	}
+
+	//only the bytes that differ count as written, so stepping between nearby states (rewind) keeps
+	//the decode cache and compiled blocks for the code that didn't change
+	unsigned int first = 0;
+	unsigned int last = MEMORY_SIZE;
+	while (first < last && memory[first] == state.memory[first])
+	{
+		++first;
+	}
+	while (last > first && memory[last - 1] == state.memory[last - 1])
+	{
+		--last;
+	}
+	restoreState(state, first, last);
+	return true;
+}
+
+void Chip8::restoreState(const SaveState& state, unsigned int first, unsigned int last)
+{
+	randomState = state.randomState;
+
+	memcpy(stack, state.stack, sizeof(stack));
+	pc = state.pc;
+	index = state.index;
+	opcode = state.opcode;
+	sp = state.sp;
+	delayTimer = state.delayTimer;
+	soundTimer = state.soundTimer;
+	memcpy(registers, state.registers, sizeof(registers));
+	memcpy(keypad, state.keypad, sizeof(keypad));
+	keyWait = false;	//found out again the next time Fx0A runs
+
+	if (first < last)
+	{
+		memcpy(memory + first, state.memory + first, last - first);
+		invalidateCode(first, last - first);
+	}
+
+	memcpy(video, state.video, sizeof(video));
+	if (packedVideo)
+	{
+		packVideo();
+	}
+	dirtyRows = 0xFFFFFFFFu;
+}
+
 	// Following opcode implementations are based from
 	// http://www.cs.columbia.edu/~sedwards/classes/2016/4840-spring/designs/Chip8.pdf
 	// https://austinmorlan.com/posts/chip8_emulator/#source-code - used this to fix the many opcode bugs I found
@@ -175,34 +956,34 @@ void Chip8::OP_NULL()
 
 void Chip8::OP_00E0()
 {
-	memset(video, 0, sizeof(video));
+	dirtyRows = 0xFFFFFFFFu;
+	if (packedVideo)
+	{
+		memset(videoRows, 0, sizeof(videoRows));
+		videoExpanded = false;
+		return;
+	}
+	exec00E0(video);
 }
 
 void Chip8::OP_00EE()
 {
-	--sp;
-	pc = stack[sp];
+	exec00EE(StackFile{ stack }, sp, pc);
 }
 
 void Chip8::OP_1nnn()
 {
-	uint16_t addr = opcode & 0x0FFFu;
-	pc = addr;
+	exec1nnn(op, pc);
 }
 
 void Chip8::OP_2nnn()
 {
-	uint16_t addr = opcode & 0x0FFFu;
-	stack[sp] = pc;
-	pc = addr;
-	++sp;
+	exec2nnn(op, StackFile{ stack }, sp, pc);
 }
 
 void Chip8::OP_3xkk()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t byte = opcode & 0x00FFu;
-	if (registers[Vx] == byte)
+	if (skip3xkk(op, RegisterFile{ registers }))
 	{
 		pc += 2;
 	}
@@ -210,9 +991,7 @@ void Chip8::OP_3xkk()
 
 void Chip8::OP_4xkk()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t byte = opcode & 0x00FFu;
-	if (registers[Vx] != byte)
+	if (skip4xkk(op, RegisterFile{ registers }))
 	{
 		pc += 2;
 	}
@@ -220,9 +999,7 @@ void Chip8::OP_4xkk()
 
 void Chip8::OP_5xy0()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	if (registers[Vx] == registers[Vy])
+	if (skip5xy0(op, RegisterFile{ registers }))
 	{
 		pc += 2;
 	}
@@ -230,113 +1007,62 @@ void Chip8::OP_5xy0()
 
 void Chip8::OP_6xkk()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t byte = opcode & 0x00FFu;
-	registers[Vx] = byte;
+	exec6xkk(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_7xkk()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t byte = opcode & 0x00FFu;
-	registers[Vx] += byte;
+	exec7xkk(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_8xy0()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	registers[Vx] = registers[Vy];
+	exec8xy0(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_8xy1()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	registers[Vx] |= registers[Vy];
+	exec8xy1(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_8xy2()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	registers[Vx] &= registers[Vy];
+	exec8xy2(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_8xy3()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	registers[Vx] ^= registers[Vy];
+	exec8xy3(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_8xy4()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	uint16_t sum = registers[Vx] + registers[Vy];
-	if (sum > 255U)
-	{
-		registers[0xF] = 1;
-	}
-	else
-	{
-		registers[0xF] = 0;
-	}
-	registers[Vx] = sum & 0xFFu;
+	exec8xy4(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_8xy5()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	if (registers[Vx] > registers[Vy])
-	{
-		registers[0xF] = 1;
-	}
-	else
-	{
-		registers[0xF] = 0;
-	}
-	registers[Vx] -= registers[Vy];
+	exec8xy5(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_8xy6()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	// Save LSB in VF
-	registers[0xF] = (registers[Vx] & 0x1u);
-	registers[Vx] >>= 1;
+	exec8xy6(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_8xy7()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	if (registers[Vy] > registers[Vx])
-	{
-		registers[0xF] = 1;
-	}
-	else
-	{
-		registers[0xF] = 0;
-	}
-	registers[Vx] = registers[Vy] - registers[Vx];
+	exec8xy7(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_8xyE()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	// Save MSB in VF
-	registers[0xF] = (registers[Vx] & 0x80u) >> 7u;
-	registers[Vx] <<= 1;
+	exec8xyE(op, RegisterFile{ registers });
 }
 
 void Chip8::OP_9xy0()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	if (registers[Vx] != registers[Vy])
+	if (skip9xy0(op, RegisterFile{ registers }))
 	{
 		pc += 2;
 	}
@@ -344,56 +1070,49 @@ void Chip8::OP_9xy0()
 
 void Chip8::OP_Annn()
 {
-	uint16_t addr = opcode & 0x0FFFu;
-	index = addr;
+	execAnnn(op, index);
 }
 
 void Chip8::OP_Bnnn()
 {
-	uint16_t addr = opcode & 0x0FFFu;
-	pc = registers[0] + addr;
+	execBnnn(op, RegisterFile{ registers }, pc);
 }
 
 void Chip8::OP_Cxkk()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t byte = opcode & 0x00FFu;
-	registers[Vx] = randByte(randGen) & byte;
+	execCxkk(op, RegisterFile{ registers }, randomState);
 }
 
 void Chip8::OP_Dxyn()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-	uint8_t height = opcode & 0x000Fu;
+	uint8_t height = op.n;
+	uint8_t x = registers[op.x] % VIDEO_WIDTH;
+	uint8_t y = registers[op.y] % VIDEO_HEIGHT;
 
-	uint8_t x = registers[Vx] % VIDEO_WIDTH;
-	uint8_t y = registers[Vy] % VIDEO_HEIGHT;
+	// rows past the bottom shift out of the mask, same as they're clipped below
+	dirtyRows |= ((1u << height) - 1u) << y;
 
-	registers[0xF] = 0;
-
-	for (unsigned int i = 0; i < height; ++i)
+	if (packedVideo)
 	{
-		for (unsigned int j = 0; j < 8; ++j)
+		// sprite byte lined up with the row's MSB, then shifted into place; bits past x = 63 fall off
+		uint8_t collision = 0;
+		for (unsigned int i = 0; i < height && y + i < VIDEO_HEIGHT; ++i)
 		{
-			uint8_t spritePixel = memory[index + i] & (0x80u >> j);
-			uint8_t* screenPixel = &video[(y + i) * VIDEO_WIDTH + (x + j)];
-			if (spritePixel)
-			{
-				if (*screenPixel == 0xFF)
-				{
-					registers[0xF] = 1;
-				}
-				*screenPixel ^= 0xFF;
-			}
+			uint64_t sprite = (static_cast<uint64_t>(memory[index + i]) << 56u) >> x;
+			collision |= (videoRows[y + i] & sprite) != 0;
+			videoRows[y + i] ^= sprite;
 		}
+		registers[0xF] = collision;
+		videoExpanded = false;
+		return;
 	}
+
+	execDxyn(op, RegisterFile{ registers }, memory, index, video);
 }
 
 void Chip8::OP_Ex9E()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	if (keypad[registers[Vx]])
+	if (skipEx9E(op, RegisterFile{ registers }, keypad))
 	{
 		pc += 2;
 	}
@@ -401,8 +1120,7 @@ void Chip8::OP_Ex9E()
 
 void Chip8::OP_ExA1()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	if (!keypad[registers[Vx]])
+	if (skipExA1(op, RegisterFile{ registers }, keypad))
 	{
 		pc += 2;
 	}
@@ -410,24 +1128,14 @@ void Chip8::OP_ExA1()
 
 void Chip8::OP_Fx07()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	registers[Vx] = delayTimer;
+	execFx07(op, RegisterFile{ registers }, delayTimer);
 }
 
 void Chip8::OP_Fx0A()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	bool unPressed = false;
-	for (int i = 0; i < 16; ++i)
-	{
-		if (keypad[i])
-		{
-			registers[Vx] = i;
-			break;
-		}
-		unPressed = true;
-	}
-	if(unPressed)
+	//no key down: blocked here, running this instruction again until there is
+	keyWait = !execFx0A(op, RegisterFile{ registers }, keypad);
+	if (keyWait)
 	{
 		pc -= 2;
 	}
@@ -435,74 +1143,37 @@ void Chip8::OP_Fx0A()
 
 void Chip8::OP_Fx15()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	delayTimer = registers[Vx];
+	execFx15(op, RegisterFile{ registers }, delayTimer);
 }
 
 void Chip8::OP_Fx18()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	soundTimer = registers[Vx];
+	execFx18(op, RegisterFile{ registers }, soundTimer);
 }
 
 void Chip8::OP_Fx1E()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	index += registers[Vx];
+	execFx1E(op, RegisterFile{ registers }, index);
 }
 
 void Chip8::OP_Fx29()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	index = FONTSET_START_ADDRESS + (5 * registers[Vx]);
+	execFx29(op, RegisterFile{ registers }, index);
 }
 
 void Chip8::OP_Fx33()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t value = registers[Vx];
-	memory[index + 2] = value % 10;
-	value /= 10;
-	memory[index + 1] = value % 10;
-	value /= 10;
-	memory[index] = value % 10;
+	execFx33(op, RegisterFile{ registers }, memory, index);
+	invalidateCode(index, 3);
 }
 
 void Chip8::OP_Fx55()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	for (uint8_t i = 0; i <= Vx; ++i)
-	{
-		memory[index + i] = registers[i];
-	}
+	execFx55(op, RegisterFile{ registers }, memory, index);
+	invalidateCode(index, op.x + 1u);
 }
 
 void Chip8::OP_Fx65()
 {
-	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	for (uint8_t i = 0; i <= Vx; ++i)
-	{
-		registers[i] = memory[index + i];
-	}
-}
-
-void Chip8::Table0()
-{
-	((*this).*(table0[opcode & 0x000Fu]))();
+	execFx65(op, RegisterFile{ registers }, memory, index);
 }
-
-void Chip8::Table8()
-{
-	((*this).*(table8[opcode & 0x000Fu]))();
-}
-
-void Chip8::TableE()
-{
-	((*this).*(tableE[opcode & 0x000Fu]))();
-}
-
-void Chip8::TableF()
-{
-	((*this).*(tableF[opcode & 0x00FFu]))();
-}
-
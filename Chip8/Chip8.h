@@ -1,15 +1,26 @@
 #pragma once
 
+#include "Decoder.h"
 #include <cstdint>
-#include <random>
-#include <SFML/Graphics.hpp>
+#include <memory>
+#include <string>
+
+class Jit;
+struct SaveState;
+#ifdef CHIP8_PROFILE
+class Profiler;
+#endif
 
 const unsigned int KEY_COUNT = 16;
 const unsigned int MEMORY_SIZE = 4096;
+const unsigned int ADDRESS_MASK = MEMORY_SIZE - 1;	//instructions are fetched at pc & ADDRESS_MASK, so running off the end wraps to 0
 const unsigned int REGISTER_COUNT = 16;
 const unsigned int STACK_LEVELS = 16;
 const unsigned int VIDEO_HEIGHT = 32;
 const unsigned int VIDEO_WIDTH = 64;
+const unsigned int TIMER_FREQUENCY = 60;
+const unsigned int FONTSET_START_ADDRESS = 0x50;
+const unsigned int START_ADDRESS = 0x200;
 
 
 /*
@@ -29,16 +40,80 @@ const unsigned int VIDEO_WIDTH = 64;
 class Chip8
 {
 public:
-	//default constructor
+	//default constructor; the random generator starts from a seed taken from the clock
 	Chip8();
+	~Chip8();
+
+	//map the ROM file (see MappedFile.h) and load it; false if it can't be opened or doesn't fit
+	bool loadROM(std::string file);
+
+	//load a ROM image already in memory, no file I/O or console output; false if it doesn't fit
+	//either loadROM keeps the machine as loaded, for reset()
+	bool loadROM(const uint8_t* data, size_t size);
+
+	//back to the machine as it was right after the last loadROM, random generator included, without
+	//constructing a new one; only the memory written since goes back, so decoded and compiled code
+	//for the rest survives. false if no ROM has been loaded
+	bool reset();
 
-	//load ROM into memory from 
-	void loadROM(std::string file);
+	//how instructions get from memory to their handler
+	enum class Engine
+	{
+		Table,	//fetch and decode every cycle, then call through the handler table
+		Cached,	//decode each address once, reuse until that memory is written
+		Jit,	//x86-64 basic-block recompiler, falls back to Cached when unavailable
+		Switch	//one dispatch loop calling handlers directly (computed goto on GCC/Clang)
+	};
+	void setEngine(Engine e);
+
+	//start OP_Cxkk's generator (see Random.h) from seed: the same seed, ROM and input replay the same run
+	void setSeed(uint64_t seed);
+
+#ifdef CHIP8_PROFILE
+	//count every instruction from here on into profiler (see Profiler.h), nullptr to stop
+	void setProfiler(Profiler* p);
+#endif
 
 	//fetch opcode, decode, next execute
 	void cycle();
 
+	//run count cycles back to back with the selected engine
+	//timers are not touched here: they count down at 60 Hz, see tickTimers()
+	void run(unsigned int count);
+
+	//one 60 Hz frame: instructionsPerFrame cycles, then one timer tick
+	//while waitingForKey() the cycles are skipped, since they would only be Fx0A waiting again
+	void runFrame(unsigned int instructionsPerFrame);
+
+	//blocked on Fx0A with no key down: until a key goes down only the timers change, so a frame
+	//costs a timer tick and the frame loop has nothing to do but wait for input
+	bool waitingForKey();
+
+	//count the delay and sound timers down by one; call at TIMER_FREQUENCY
+	void tickTimers();
+
+	//keep the screen as one uint64_t per row (bit 63 = leftmost pixel) instead of a byte per pixel,
+	//so a sprite row draws with one shift, XOR and AND
+	void setPackedVideo(bool packed);
+
+	//byte-per-pixel screen (0xFF on, 0x00 off); expands the packed rows first when needed
+	const uint8_t* getVideo();
+
+	//rows of video that OP_Dxyn/OP_00E0 touched since the last call (bit n = row n), then clears them
+	uint32_t takeDirtyRows();
+
+	//copy the machine into state (see SaveState.h), random generator included
+	void saveState(SaveState& state);
+
+	//carry on from state; false, leaving the machine alone, if state isn't one this build can load
+	bool loadState(const SaveState& state);
+
+	//memory[first, last) covers every byte written since the last call (loadROM, OP_Fx33, OP_Fx55, loadState)
+	//returns false when nothing was written; before the first call, all of memory counts as written
+	bool takeWrittenMemory(unsigned int& first, unsigned int& last);
+
 	//public so they can be accessed by the Display class
+	//with packed video on, video is only up to date after getVideo()
 	uint8_t keypad[KEY_COUNT]{};
 	uint8_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
 	
@@ -49,20 +124,72 @@ public:
 	uint8_t getDelayTimer();
 	uint8_t* getRegisters();
 	uint16_t* getStack();
+	const uint8_t* getMemory();
+
+	//how many times the cached engine has run each Fusion (Decoder.h), indexed by Fusion
+	const uint64_t* getFusionCounts();
+
+	//instructions counted as run without being emulated, because the program was spinning in an
+	//idle loop that nothing inside run() could break (see skipIdle)
+	uint64_t getElidedInstructions();
 
 private:
-	//Initialize tables of opcode function pointers - need typedef so it doesn't look stupid :)
-	//By default, these tables will be filled by reference to OP_NULL, which does nothing
-	//Actual opcodes are added to the tables in Chip8.cpp
+	friend class Jit;
+
+	//opcode function pointers - need typedef so it doesn't look stupid :)
+	//one handler per OpKind (see Decoder.h), shared by every instance and built at compile time
 	typedef void (Chip8::* OpRef)();
-	OpRef table[0xF + 1]{ &Chip8::OP_NULL };
-	OpRef table0[0xE + 1]{ &Chip8::OP_NULL };	//master table: will contain opcodes that do not start with the aforementioned letters/numbers, 
-	OpRef table8[0xE + 1]{ &Chip8::OP_NULL };	//alongside references to the 4 functions that direct to other 4 tables
-	OpRef tableE[0xE + 1]{ &Chip8::OP_NULL };	//reminder: 1 is added to the hex value because the max array index is 1-size,
-	OpRef tableF[0x65 + 1]{ &Chip8::OP_NULL };  //and the last digit of the hex value corresponds with the last digit of the opcode.
+	static const OpRef handlers[OP_KIND_COUNT];
 
-	std::default_random_engine randGen;
-	std::uniform_int_distribution<> randByte;
+	//decode cache entry: the handler plus the decoded instruction
+	//a null handler means the address hasn't been decoded yet, or was overwritten since
+	struct DecodedOp
+	{
+		OpRef handler;
+		uint16_t opcode;
+		Instruction instruction;
+		Fusion fusion;	//the superinstruction starting here, if any
+	};
+
+	Engine engine = Engine::Table;
+	std::unique_ptr<DecodedOp[]> decodeCache;	//one entry per address, allocated for the Cached and Jit engines
+	std::unique_ptr<Jit> jit;
+	Instruction op{};	//the instruction being executed
+
+	void cycleTable();
+	void cycleCached();
+	void runCached(unsigned int count);
+	DecodedOp& decodeAt(unsigned int address);
+	unsigned int runFused(const DecodedOp& decoded);
+	uint64_t fusionCounts[FUSION_COUNT]{};
+
+	//after a jump back to pc: if the loop there is idle, finish the remaining budget in one step
+	//returns how many instructions that accounted for (all of remaining, or 0)
+	unsigned int skipIdle(unsigned int remaining);
+	bool skipTaken(const Instruction& skip);
+	Instruction instructionAt(unsigned int address);
+	uint64_t elidedInstructions = 0;
+	bool keyWait = false;	//the last instruction was Fx0A finding no key
+	bool anyKeyDown();
+	void runSwitch(unsigned int count);
+#ifdef CHIP8_PROFILE
+	Profiler* profiler = nullptr;
+	void runProfiled(unsigned int count);
+#endif
+	//every write to memory comes through here: drops decoded instructions that overlap
+	//memory[address, address + length) and adds the range to the written span
+	void invalidateCode(unsigned int address, unsigned int length);
+	unsigned int writtenFirst = 0;
+	unsigned int writtenLast = MEMORY_SIZE;
+	//same, but since the last loadROM or reset: what reset() has to copy back
+	unsigned int changedFirst = 0;
+	unsigned int changedLast = 0;
+
+	std::unique_ptr<SaveState> pristine;	//the machine as loaded
+	//take everything but memory from state, and memory[first, last) too
+	void restoreState(const SaveState& state, unsigned int first, unsigned int last);
+
+	uint64_t randomState = 0;
 
 	uint8_t registers[REGISTER_COUNT]{};
 	uint8_t memory[MEMORY_SIZE]{};
@@ -72,15 +199,14 @@ private:
 	uint8_t sp{};
 	uint8_t delayTimer{};
 	uint8_t soundTimer{};
-	uint16_t opcode;
-
-	//These functions will dereference the pointer to the opcode functions for their table.
-	//For example, when opcode=0x00E0, table0[(0x00E0 & 0x000F)] = table0[(0x0)], which returns a pointer to Chip8::OP_00E0
-	//These tables are used because many opcodes can be grouped by their starting values: 00, 8xy, Ex, or Fx
-	void Table0();
-	void Table8();
-	void TableE();
-	void TableF();
+	uint16_t opcode{};
+
+	bool packedVideo = false;
+	bool videoExpanded = true;	//video matches videoRows
+	uint64_t videoRows[VIDEO_HEIGHT]{};
+	uint32_t dirtyRows = 0xFFFFFFFFu;	//everything, so the first frame gets presented
+	void packVideo();
+	void expandVideo();
 
 	// Following opcode implementations are based from
     // http://www.cs.columbia.edu/~sedwards/classes/2016/4840-spring/designs/Chip8.pdf
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+	The one CHIP-8 instruction decoder. Chip8 (every engine) and the Display disassembler both go
+	through decode(), so what an opcode means is defined in exactly one place. Everything here is
+	constexpr: there are no tables to build at startup and nothing is stored per instance.
+
+	Opcodes that don't match an instruction exactly decode to OpKind::Null, which does nothing.
+*/
+
+enum class OpKind : uint8_t
+{
+	Null,
+	Op00E0,	//CLS
+	Op00EE,	//RET
+	Op1nnn,	//JP address
+	Op2nnn,	//CALL address
+	Op3xkk,	//SE Vx, byte
+	Op4xkk,	//SNE Vx, byte
+	Op5xy0,	//SE Vx, Vy
+	Op6xkk,	//LD Vx, byte
+	Op7xkk,	//ADD Vx, byte
+	Op8xy0,	//LD Vx, Vy
+	Op8xy1,	//OR Vx, Vy
+	Op8xy2,	//AND Vx, Vy
+	Op8xy3,	//XOR Vx, Vy
+	Op8xy4,	//ADD Vx, Vy
+	Op8xy5,	//SUB Vx, Vy
+	Op8xy6,	//SHR Vx
+	Op8xy7,	//SUBN Vx, Vy
+	Op8xyE,	//SHL Vx
+	Op9xy0,	//SNE Vx, Vy
+	OpAnnn,	//LD I, address
+	OpBnnn,	//JP V0, address
+	OpCxkk,	//RND Vx, byte
+	OpDxyn,	//DRW Vx, Vy, height
+	OpEx9E,	//SKP Vx
+	OpExA1,	//SKNP Vx
+	OpFx07,	//LD Vx, DT
+	OpFx0A,	//LD Vx, K
+	OpFx15,	//LD DT, Vx
+	OpFx18,	//LD ST, Vx
+	OpFx1E,	//ADD I, Vx
+	OpFx29,	//LD F, Vx
+	OpFx33,	//LD B, Vx
+	OpFx55,	//LD [I], Vx
+	OpFx65,	//LD Vx, [I]
+	Count
+};
+
+const size_t OP_KIND_COUNT = static_cast<size_t>(OpKind::Count);
+
+//a decoded instruction: what it is plus every operand field, pulled out once
+struct Instruction
+{
+	OpKind kind;
+	uint8_t x;
+	uint8_t y;
+	uint8_t kk;
+	uint8_t n;
+	uint16_t nnn;
+};
+
+//the definition of every instruction; decodeKind() reads the same answers out of KIND_TABLE
+constexpr OpKind classifyOpcode(uint16_t opcode)
+{
+	switch ((opcode & 0xF000u) >> 12u)
+	{
+	case 0x0:
+		return opcode == 0x00E0 ? OpKind::Op00E0 : opcode == 0x00EE ? OpKind::Op00EE : OpKind::Null;
+	case 0x1:
+		return OpKind::Op1nnn;
+	case 0x2:
+		return OpKind::Op2nnn;
+	case 0x3:
+		return OpKind::Op3xkk;
+	case 0x4:
+		return OpKind::Op4xkk;
+	case 0x5:
+		return (opcode & 0x000Fu) == 0x0 ? OpKind::Op5xy0 : OpKind::Null;
+	case 0x6:
+		return OpKind::Op6xkk;
+	case 0x7:
+		return OpKind::Op7xkk;
+	case 0x8:
+		switch (opcode & 0x000Fu)
+		{
+		case 0x0: return OpKind::Op8xy0;
+		case 0x1: return OpKind::Op8xy1;
+		case 0x2: return OpKind::Op8xy2;
+		case 0x3: return OpKind::Op8xy3;
+		case 0x4: return OpKind::Op8xy4;
+		case 0x5: return OpKind::Op8xy5;
+		case 0x6: return OpKind::Op8xy6;
+		case 0x7: return OpKind::Op8xy7;
+		case 0xE: return OpKind::Op8xyE;
+		default: return OpKind::Null;
+		}
+	case 0x9:
+		return (opcode & 0x000Fu) == 0x0 ? OpKind::Op9xy0 : OpKind::Null;
+	case 0xA:
+		return OpKind::OpAnnn;
+	case 0xB:
+		return OpKind::OpBnnn;
+	case 0xC:
+		return OpKind::OpCxkk;
+	case 0xD:
+		return OpKind::OpDxyn;
+	case 0xE:
+		switch (opcode & 0x00FFu)
+		{
+		case 0x9E: return OpKind::OpEx9E;
+		case 0xA1: return OpKind::OpExA1;
+		default: return OpKind::Null;
+		}
+	default:
+		switch (opcode & 0x00FFu)
+		{
+		case 0x07: return OpKind::OpFx07;
+		case 0x0A: return OpKind::OpFx0A;
+		case 0x15: return OpKind::OpFx15;
+		case 0x18: return OpKind::OpFx18;
+		case 0x1E: return OpKind::OpFx1E;
+		case 0x29: return OpKind::OpFx29;
+		case 0x33: return OpKind::OpFx33;
+		case 0x55: return OpKind::OpFx55;
+		case 0x65: return OpKind::OpFx65;
+		default: return OpKind::Null;
+		}
+	}
+}
+
+//an instruction's kind depends on its first digit and its low byte, except 00E0/00EE which also
+//need x == 0, so a table indexed by those 12 bits answers every opcode with one load
+struct KindTable
+{
+	OpKind kinds[0x1000];
+};
+
+constexpr KindTable makeKindTable()
+{
+	KindTable table{};
+	for (unsigned int i = 0; i < 0x1000; ++i)
+	{
+		table.kinds[i] = classifyOpcode(static_cast<uint16_t>(((i & 0xF00u) << 4u) | (i & 0x0FFu)));
+	}
+	return table;
+}
+
+inline constexpr KindTable KIND_TABLE = makeKindTable();
+
+constexpr OpKind decodeKind(uint16_t opcode)
+{
+	//0x0xkk with x != 0 would otherwise alias 00E0/00EE
+	return (opcode & 0xFF00u) != 0 && (opcode & 0xF000u) == 0 ? OpKind::Null
+		: KIND_TABLE.kinds[((opcode & 0xF000u) >> 4u) | (opcode & 0x00FFu)];
+}
+
+constexpr Instruction decode(uint16_t opcode)
+{
+	return Instruction{
+		decodeKind(opcode),
+		static_cast<uint8_t>((opcode & 0x0F00u) >> 8u),
+		static_cast<uint8_t>((opcode & 0x00F0u) >> 4u),
+		static_cast<uint8_t>(opcode & 0x00FFu),
+		static_cast<uint8_t>(opcode & 0x000Fu),
+		static_cast<uint16_t>(opcode & 0x0FFFu)
+	};
+}
+
+static_assert(decode(0x00E0).kind == OpKind::Op00E0, "CLS");
+static_assert(decode(0x8AB4).kind == OpKind::Op8xy4 && decode(0x8AB4).x == 0xA && decode(0x8AB4).y == 0xB, "ADD Vx, Vy");
+static_assert(decode(0xC3F0).x == 0x3 && decode(0xC3F0).kk == 0xF0, "RND Vx, byte");
+static_assert(decode(0xE19F).kind == OpKind::Null, "Ex9F is not an instruction");
+static_assert(decode(0x01E0).kind == OpKind::Null, "0nnn is ignored");
+
+/*
+	Superinstructions: short runs of instructions that programs use together, which the cached engine
+	runs as one step instead of dispatching each. A fusion only describes what sits in memory; running
+	one has to come out exactly as running its instructions one at a time would.
+*/
+
+enum class Fusion : uint8_t
+{
+	None,
+	SkipJump,	//3xkk/4xkk/5xy0/9xy0/Ex9E/ExA1, then 1nnn: a conditional branch
+	Load2,	//6xkk, 6xkk
+	Load3,	//6xkk, 6xkk, 6xkk
+	IndexDraw,	//Annn, Dxyn: point I at a sprite and draw it
+	TimerPoll,	//Fx07, then a skip and 1nnn: a loop waiting on the delay timer
+	Count
+};
+
+const size_t FUSION_COUNT = static_cast<size_t>(Fusion::Count);
+const unsigned int MAX_FUSED_INSTRUCTIONS = 3;
+
+constexpr bool isSkip(OpKind kind)
+{
+	return kind == OpKind::Op3xkk || kind == OpKind::Op4xkk || kind == OpKind::Op5xy0
+		|| kind == OpKind::Op9xy0 || kind == OpKind::OpEx9E || kind == OpKind::OpExA1;
+}
+
+//the fusion starting with first, given the two instructions after it (Null past the end of memory)
+constexpr Fusion classifyFusion(const Instruction& first, const Instruction& second, const Instruction& third)
+{
+	if (first.kind == OpKind::Op6xkk && second.kind == OpKind::Op6xkk)
+	{
+		return third.kind == OpKind::Op6xkk ? Fusion::Load3 : Fusion::Load2;
+	}
+	if (isSkip(first.kind) && second.kind == OpKind::Op1nnn)
+	{
+		return Fusion::SkipJump;
+	}
+	if (first.kind == OpKind::OpAnnn && second.kind == OpKind::OpDxyn)
+	{
+		return Fusion::IndexDraw;
+	}
+	if (first.kind == OpKind::OpFx07 && isSkip(second.kind) && third.kind == OpKind::Op1nnn)
+	{
+		return Fusion::TimerPoll;
+	}
+	return Fusion::None;
+}
+
+//the most instructions a fusion runs; it only runs when that many are left in the budget
+constexpr unsigned int fusionLength(Fusion fusion)
+{
+	return fusion == Fusion::None ? 1 : fusion == Fusion::Load3 || fusion == Fusion::TimerPoll ? 3 : 2;
+}
+
+constexpr const char* fusionName(Fusion fusion)
+{
+	switch (fusion)
+	{
+	case Fusion::SkipJump: return "skip+jump";
+	case Fusion::Load2: return "load x2";
+	case Fusion::Load3: return "load x3";
+	case Fusion::IndexDraw: return "index+draw";
+	case Fusion::TimerPoll: return "timer poll";
+	default: return "none";
+	}
+}
+
+static_assert(classifyFusion(decode(0x3A00), decode(0x1208), decode(0x0000)) == Fusion::SkipJump, "skip+jump");
+static_assert(classifyFusion(decode(0x6001), decode(0x6102), decode(0x6203)) == Fusion::Load3, "three loads");
+static_assert(classifyFusion(decode(0xF507), decode(0x3500), decode(0x1300)) == Fusion::TimerPoll, "timer poll");
+static_assert(classifyFusion(decode(0xA300), decode(0x8AB4), decode(0x0000)) == Fusion::None, "Annn alone");
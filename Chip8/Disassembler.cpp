@@ -0,0 +1,129 @@
+#include "Disassembler.h"
+#include <cstdio>
+#include <cstring>
+
+// Mnemonics from http://devernay.free.fr/hacks/chip8/C8TECH10.HTM, indexed by OpKind.
+// $x/$y are the register digits, $k the byte, $n the nibble, $a the address and $o the whole opcode.
+static const char* const MNEMONICS[OP_KIND_COUNT] =
+{
+	"DW $o",
+	"CLS",
+	"RET",
+	"JP $a",
+	"CALL $a",
+	"SE V$x, $k",
+	"SNE V$x, $k",
+	"SE V$x, V$y",
+	"LD V$x, $k",
+	"ADD V$x, $k",
+	"LD V$x, V$y",
+	"OR V$x, V$y",
+	"AND V$x, V$y",
+	"XOR V$x, V$y",
+	"ADD V$x, V$y",
+	"SUB V$x, V$y",
+	"SHR V$x",
+	"SUBN V$x, V$y",
+	"SHL V$x",
+	"SNE V$x, V$y",
+	"LD I, $a",
+	"JP V0, $a",
+	"RND V$x, $k",
+	"DRW V$x, V$y, $n",
+	"SKP V$x",
+	"SKNP V$x",
+	"LD V$x, DT",
+	"LD V$x, K",
+	"LD DT, V$x",
+	"LD ST, V$x",
+	"ADD I, V$x",
+	"LD F, V$x",
+	"LD B, V$x",
+	"LD [I], V$x",
+	"LD V$x, [I]"
+};
+
+Disassembler::Disassembler()
+	: lines(new char[MEMORY_SIZE * DISASSEMBLY_LINE_LENGTH]{})
+{}
+
+unsigned int Disassembler::format(uint16_t opcode, char* out, size_t size)
+{
+	if (size == 0)
+	{
+		return 0;
+	}
+
+	Instruction instruction = decode(opcode);
+	size_t length = 0;
+	for (const char* c = MNEMONICS[static_cast<size_t>(instruction.kind)]; *c && length + 1 < size; ++c)
+	{
+		if (*c != '$')
+		{
+			out[length++] = *c;
+			continue;
+		}
+
+		// an operand: snprintf into what's left of out, which stops at the end of the buffer
+		int written = 0;
+		switch (*++c)
+		{
+		case 'x':
+			written = std::snprintf(out + length, size - length, "%X", instruction.x);
+			break;
+		case 'y':
+			written = std::snprintf(out + length, size - length, "%X", instruction.y);
+			break;
+		case 'k':
+			written = std::snprintf(out + length, size - length, "0x%02X", instruction.kk);
+			break;
+		case 'n':
+			written = std::snprintf(out + length, size - length, "%u", instruction.n);
+			break;
+		case 'a':
+			written = std::snprintf(out + length, size - length, "0x%03X", instruction.nnn);
+			break;
+		default:
+			written = std::snprintf(out + length, size - length, "0x%04X", opcode);
+			break;
+		}
+		length += static_cast<size_t>(written) < size - length ? written : size - length - 1;
+	}
+	out[length] = '\0';
+	return static_cast<unsigned int>(length);
+}
+
+void Disassembler::refresh(const uint8_t* memory, unsigned int address, unsigned int length)
+{
+	//the instruction at address - 1 reads its second byte from address
+	unsigned int first = address > 0 ? address - 1 : 0;
+	unsigned int last = address + length < MEMORY_SIZE ? address + length : MEMORY_SIZE;
+	for (unsigned int i = first; i < last; ++i)
+	{
+		//the last byte of memory has nothing after it, so its second byte reads as 0
+		uint16_t opcode = (memory[i] << 8u) | (i + 1 < MEMORY_SIZE ? memory[i + 1] : 0);
+		char* line = &lines[i * DISASSEMBLY_LINE_LENGTH];
+		int prefix = std::snprintf(line, DISASSEMBLY_LINE_LENGTH, "0x%03X  %04X  ", i, opcode);
+		format(opcode, line + prefix, DISASSEMBLY_LINE_LENGTH - prefix);
+	}
+}
+
+const char* Disassembler::line(unsigned int address) const
+{
+	return &lines[address * DISASSEMBLY_LINE_LENGTH];
+}
+
+void Disassembler::window(uint16_t pc, unsigned int count, char* out) const
+{
+	int address = pc - static_cast<int>(count / 2) * 2;
+	for (unsigned int i = 0; i < count; ++i, address += 2)
+	{
+		char* outLine = out + i * DISASSEMBLY_LINE_LENGTH;
+		if (address < 0 || address >= static_cast<int>(MEMORY_SIZE))
+		{
+			outLine[0] = '\0';
+			continue;
+		}
+		memcpy(outLine, line(address), DISASSEMBLY_LINE_LENGTH);
+	}
+}
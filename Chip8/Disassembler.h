@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Chip8.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+const unsigned int DISASSEMBLY_LINE_LENGTH = 32;	//one listing line, terminator included
+
+/*
+	Formats instructions into caller-provided buffers, never allocating.
+
+	A Disassembler also keeps a listing of every address in memory, built once and refreshed only
+	where the program writes (see Chip8::takeWrittenMemory), so showing the code around pc is a copy.
+	Any address gets a line, odd ones included, since programs can jump anywhere.
+*/
+
+class Disassembler
+{
+public:
+	Disassembler();
+
+	//"LD VA, 0x02" for opcode into out (size bytes, always terminated); returns the length written
+	static unsigned int format(uint16_t opcode, char* out, size_t size);
+
+	//re-disassemble the instructions that read memory[address, address + length)
+	void refresh(const uint8_t* memory, unsigned int address, unsigned int length);
+
+	//listing line for the instruction at address: "0x200  6A02  LD VA, 0x02"
+	const char* line(unsigned int address) const;
+
+	//copy count lines, pc in the middle and the rest every 2 bytes either side, into
+	//out (count * DISASSEMBLY_LINE_LENGTH bytes); addresses outside memory come out blank
+	void window(uint16_t pc, unsigned int count, char* out) const;
+
+private:
+	std::unique_ptr<char[]> lines;	//MEMORY_SIZE lines of DISASSEMBLY_LINE_LENGTH
+};
@@ -1,57 +1,49 @@
 #include "Display.h"
 #include <SFML/Graphics.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
-#include <sstream>
 
 // References: https://www.sfml-dev.org/tutorials/2.5/
 
-Display::Display(const char* name, int texW, int texH, float windowScale)
-	: scale(windowScale)
+// the instructions whose Vx lights up in the register panel: everything that compares or
+// changes it, but not draws, key skips or the ones that only copy it somewhere else
+static bool highlightsVx(OpKind kind)
 {
-	table[0x0] = &Display::Table0;
-	table[0x1] = &Display::OP_1nnn;
-	table[0x2] = &Display::OP_2nnn;
-	table[0x3] = &Display::OP_3xkk;
-	table[0x4] = &Display::OP_4xkk;
-	table[0x5] = &Display::OP_5xy0;
-	table[0x6] = &Display::OP_6xkk;
-	table[0x7] = &Display::OP_7xkk;
-	table[0x8] = &Display::Table8;
-	table[0x9] = &Display::OP_9xy0;
-	table[0xA] = &Display::OP_Annn;
-	table[0xB] = &Display::OP_Bnnn;
-	table[0xC] = &Display::OP_Cxkk;
-	table[0xD] = &Display::OP_Dxyn;
-	table[0xE] = &Display::TableE;
-	table[0xF] = &Display::TableF;
-	table0[0x0] = &Display::OP_00E0;
-	table0[0xE] = &Display::OP_00EE;
-	table8[0x0] = &Display::OP_8xy0;
-	table8[0x1] = &Display::OP_8xy1;
-	table8[0x2] = &Display::OP_8xy2;
-	table8[0x3] = &Display::OP_8xy3;
-	table8[0x4] = &Display::OP_8xy4;
-	table8[0x5] = &Display::OP_8xy5;
-	table8[0x6] = &Display::OP_8xy6;
-	table8[0x7] = &Display::OP_8xy7;
-	table8[0xE] = &Display::OP_8xyE;
-	tableE[0x1] = &Display::OP_ExA1;
-	tableE[0xE] = &Display::OP_Ex9E;
-	tableF[0x07] = &Display::OP_Fx07;
-	tableF[0x0A] = &Display::OP_Fx0A;
-	tableF[0x15] = &Display::OP_Fx15;
-	tableF[0x18] = &Display::OP_Fx18;
-	tableF[0x1E] = &Display::OP_Fx1E;
-	tableF[0x29] = &Display::OP_Fx29;
-	tableF[0x33] = &Display::OP_Fx33;
-	tableF[0x55] = &Display::OP_Fx55;
-	tableF[0x65] = &Display::OP_Fx65;
-
-	if (!font.loadFromFile("consola.ttf"))
+	switch (kind)
 	{
-		std::cerr << "Could not load font" << std::endl;
+	case OpKind::Op3xkk:
+	case OpKind::Op4xkk:
+	case OpKind::Op5xy0:
+	case OpKind::Op6xkk:
+	case OpKind::Op7xkk:
+	case OpKind::Op8xy0:
+	case OpKind::Op8xy1:
+	case OpKind::Op8xy2:
+	case OpKind::Op8xy3:
+	case OpKind::Op8xy4:
+	case OpKind::Op8xy5:
+	case OpKind::Op8xy6:
+	case OpKind::Op8xy7:
+	case OpKind::Op8xyE:
+	case OpKind::Op9xy0:
+	case OpKind::OpCxkk:
+	case OpKind::OpFx07:
+	case OpKind::OpFx0A:
+	case OpKind::OpFx65:
+		return true;
+	default:
+		return false;
 	}
-	window.create(sf::VideoMode(sf::Vector2u(texW * scale + 15 * scale, texH * scale)), name);
+}
+
+Display::Display(const char* name, int texW, int texH, float windowScale, unsigned int panelRefreshRate,
+	const Palette& palette)
+	: palette(palette), scale(windowScale), panelRefreshRate(panelRefreshRate)
+{
+	unsigned int panelWidth = panelRefreshRate > 0 ? 33 * scale : 0;
+	window.create(sf::VideoMode(sf::Vector2u(texW * scale + panelWidth, texH * scale)), name);
 	if (!texture.create(sf::Vector2u(texW, texH)))
 	{
 		std::cerr << "Could not create texture" << std::endl;
@@ -61,104 +53,229 @@ Display::Display(const char* name, int texW, int texH, float windowScale)
 	window.display();
 }
 
-void Display::updateDisplay(const uint8_t* video, const uint16_t op,  const uint16_t pc, const uint16_t i,
-	const uint8_t sp, const uint8_t dt, const uint8_t* registers, const uint16_t* stack)
+void Display::initPanel()
+{
+	if (!font.loadFromFile("consola.ttf"))
+	{
+		std::cerr << "Could not load font" << std::endl;
+	}
+
+	// asking for every glyph up front puts them all on the font's texture page now,
+	// so it never has to grow (and move things around) mid-game
+	for (unsigned int c = ' '; c < 127; ++c)
+	{
+		glyphs[c] = font.getGlyph(c, scale, false);
+	}
+	cellWidth = glyphs['0'].advance;	//consola is monospaced
+	lineHeight = font.getLineSpacing(scale);
+
+	// vertices start out all zero, so blank cells are empty triangles that draw nothing
+	panel.setPrimitiveType(sf::PrimitiveType::Triangles);
+	panel.resize((PANEL_ROWS * PANEL_COLUMNS * 6) + 32 * INDICATOR_VERTICES);
+	memset(cells, ' ', sizeof(cells));
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		buildIndicator(i, sf::Vector2f(64.0f * scale + scale * 0.5f, i * scale * 1.16f + 8.8f * scale));
+		buildIndicator(16 + i, sf::Vector2f(64.0f * scale + scale * 7.8f, i * scale * 1.16f + 8.8f * scale));
+	}
+	panelReady = true;
+}
+
+void Display::updateDisplay(const uint8_t* video, const uint32_t dirtyRows, const uint16_t opcode, const uint16_t pc,
+	const uint16_t index, const uint8_t sp, const uint8_t dt, const uint8_t* registers, const uint16_t* stack,
+	const char* listing)
 {
-	opcode = op;
-	index = i;
-	delayTimer = dt;
+	// the panel gets new values at its own rate, and is redrawn unchanged in between
+	bool refreshPanel = panelRefreshRate > 0 &&
+		(!panelReady || panelClock.getElapsedTime().asSeconds() * panelRefreshRate >= 1.0f);
+
+	// nothing on screen changed, so the last presented frame is still correct
+	if (dirtyRows == 0 && !refreshPanel)
+	{
+		return;
+	}
+
 	window.clear(sf::Color::Black);
-	std::stringstream stream;
 
-	// generate debug details
-	stream << "OPCODE: " << "0x" << std::hex << opcode << std::endl;
-	stream << ((*this).*(table[(opcode & 0xF000u) >> 12u]))() << std::endl;
-	stream << "PRGM CNTR: " << "0x" << std::setw(3) <<
-		std::setfill('0') << std::hex << pc << std::endl;
-	stream << "INDEX: " << "0x" << std::setw(3) <<
-		std::setfill('0') << std::hex << index << std::endl;
-	stream << "STACK PNTER: " << "0x" << std::setw(2) <<
-		std::setfill('0') << std::hex << (int)sp << std::endl;
-	stream << std::endl;
-
-	stream << "REG:         STACK:" << std::endl;
-
-	// draw pixels from video array
-	for (int i = 0; i < 64 * 32 * 4; i+=4)
+	// draw pixels from video array, only for the rows that changed,
+	// and upload each run of consecutive dirty rows with one texture update
+	for (unsigned int row = 0; row < 32; ++row)
 	{
-		if (video[i/4] == 0xFF)
+		if (!(dirtyRows & (1u << row)))
 		{
-			pixels[i] = 0xFF;
-			pixels[i+1] = 0xFF;
-			pixels[i+2] = 0xFF;
-			pixels[i+3] = 0xFF;
+			continue;
 		}
-		else 
+		unsigned int firstRow = row;
+		while (row < 32 && (dirtyRows & (1u << row)))
 		{
-			pixels[i] = 0x00;
-			pixels[i + 1] = 0x00;
-			pixels[i + 2] = 0x00;
-			pixels[i + 3] = 0x00;
+			++row;
 		}
+		videoToRGBA(video, pixels, firstRow, row - firstRow, palette);
+		texture.update(pixels + firstRow * 64 * 4, sf::Vector2u(64, row - firstRow), sf::Vector2u(0, firstRow));
 	}
 
-	// draw register and stack indicators
-	for (int i = 0; i < 16; ++i)
+	if (refreshPanel)
 	{
-		stream << "V" << std::hex << i << ": " << "0x" << std::setw(2) <<
-			std::setfill('0') << std::hex << (int)registers[i];
-		stream << "     " << std::hex << i << ": " << "0x" << std::setw(4) <<
-			std::setfill('0') << std::hex << (int)stack[i] << std::endl;
-
-		registerIndicators[i].setRadius(scale/2.5);
-		registerIndicators[i].setOutlineColor(sf::Color::White);
-		registerIndicators[i].setOutlineThickness(2.0f);
-		
-		if (registerIndicators[i].getFillColor() != sf::Color::Red)
-		{
-			registerIndicators[i].setFillColor(sf::Color::Black);
-		}
-		
-		if (registers[0xF] != 0)
-		{
-			registerIndicators[0xF].setFillColor(sf::Color::Red);
-		}
-		else
-		{
-			registerIndicators[0xF].setFillColor(sf::Color::Black);
-		}
-		
-		registerIndicators[i].setPosition(sf::Vector2f(64.0f * scale + scale * 0.5, i * scale * 1.16 + 8.8 * scale));
-		
-		stackIndicators[i].setRadius(scale / 2.5);
-		stackIndicators[i].setOutlineColor(sf::Color::White);
-		stackIndicators[i].setOutlineThickness(2.0f);
-		if (stack[i] != 0x0000)
-		{
-			stackIndicators[i].setFillColor(sf::Color::Red);
-		}
-		else
+		if (!panelReady)
 		{
-			stackIndicators[i].setFillColor(sf::Color::Black);
+			initPanel();
 		}
-		stackIndicators[i].setPosition(sf::Vector2f(64.0f * scale + scale * 7.8, i * scale * 1.16 + 8.8 * scale));
-		
-		window.draw(registerIndicators[i]);
-		window.draw(stackIndicators[i]);
+		panelClock.restart();
+		updatePanel(opcode, pc, index, sp, registers, stack, listing);
 	}
 
-	sf::Text debug(stream.str(), font);
-	debug.setCharacterSize(scale);
-	debug.setPosition(sf::Vector2f(64.0f * scale + 2 * scale, 10.0f));
-	debug.setFillColor(sf::Color::White);
-	texture.update(pixels);
 	sprite.setTexture(texture);
 	window.draw(sprite);
-	window.draw(debug);
+	if (panelReady)
+	{
+		window.draw(panel, &font.getTexture(scale));
+	}
 	window.display();
-	for (int i = 0; i < 16; ++i)
+}
+
+void Display::updatePanel(const uint16_t opcode, const uint16_t pc, const uint16_t index, const uint8_t sp,
+	const uint8_t* registers, const uint16_t* stack, const char* listing)
+{
+	// generate debug details
+	char line[DISASSEMBLY_LINE_LENGTH + 1];
+	std::snprintf(line, sizeof(line), "OPCODE: 0x%x", opcode);
+	setText(0, 0, LISTING_COLUMN, line);
+	Disassembler::format(opcode, line, sizeof(line));
+	setText(1, 0, LISTING_COLUMN, line);
+	std::snprintf(line, sizeof(line), "PRGM CNTR: 0x%03x", pc);
+	setText(2, 0, LISTING_COLUMN, line);
+	std::snprintf(line, sizeof(line), "INDEX: 0x%03x", index);
+	setText(3, 0, LISTING_COLUMN, line);
+	std::snprintf(line, sizeof(line), "STACK PNTER: 0x%02x", sp);
+	setText(4, 0, LISTING_COLUMN, line);
+	setText(6, 0, LISTING_COLUMN, "REG:         STACK:");
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		std::snprintf(line, sizeof(line), "V%x: 0x%02x     %x: 0x%04x", i, registers[i], i, stack[i]);
+		setText(7 + i, 0, LISTING_COLUMN, line);
+	}
+
+	// the listing is already formatted, pc's line is marked
+	for (unsigned int row = 0; row < LISTING_LINES; ++row)
 	{
-		registerIndicators[i].setFillColor(sf::Color::Black);
+		setCell(row, LISTING_COLUMN, row == LISTING_LINES / 2 ? '>' : ' ');
+		setText(row, LISTING_COLUMN + 1, PANEL_COLUMNS, listing + row * DISASSEMBLY_LINE_LENGTH);
+	}
+
+	// register and stack indicators: the instruction's Vx and a set VF light up, as do used stack slots
+	Instruction instruction = decode(opcode);
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		bool lit = (highlightsVx(instruction.kind) && instruction.x == i) || (i == 0xF && registers[0xF] != 0);
+		setIndicator(i, lit);
+		setIndicator(16 + i, stack[i] != 0x0000);
+	}
+}
+
+void Display::setCell(unsigned int row, unsigned int column, char c)
+{
+	if (cells[row][column] == c)
+	{
+		return;
+	}
+	cells[row][column] = c;
+
+	unsigned char code = c >= ' ' && c < 127 ? c : '?';
+	const sf::Glyph& glyph = glyphs[code];
+	// same placement as sf::Text: the first baseline sits one character size below the top
+	float left = 64.0f * scale + 2 * scale + column * cellWidth + glyph.bounds.left;
+	float top = 10.0f + scale + row * lineHeight + glyph.bounds.top;
+	float right = left + glyph.bounds.width;
+	float bottom = top + glyph.bounds.height;
+	float u0 = static_cast<float>(glyph.textureRect.left);
+	float v0 = static_cast<float>(glyph.textureRect.top);
+	float u1 = u0 + glyph.textureRect.width;
+	float v1 = v0 + glyph.textureRect.height;
+
+	sf::Vertex* quad = &panel[(row * PANEL_COLUMNS + column) * 6];
+	quad[0].position = sf::Vector2f(left, top);		quad[0].texCoords = sf::Vector2f(u0, v0);
+	quad[1].position = sf::Vector2f(right, top);	quad[1].texCoords = sf::Vector2f(u1, v0);
+	quad[2].position = sf::Vector2f(left, bottom);	quad[2].texCoords = sf::Vector2f(u0, v1);
+	quad[3].position = sf::Vector2f(left, bottom);	quad[3].texCoords = sf::Vector2f(u0, v1);
+	quad[4].position = sf::Vector2f(right, top);	quad[4].texCoords = sf::Vector2f(u1, v0);
+	quad[5].position = sf::Vector2f(right, bottom);	quad[5].texCoords = sf::Vector2f(u1, v1);
+	for (unsigned int i = 0; i < 6; ++i)
+	{
+		quad[i].color = sf::Color::White;
+	}
+}
+
+void Display::setText(unsigned int row, unsigned int column, unsigned int end, const char* text)
+{
+	for (; column < end && *text; ++column, ++text)
+	{
+		setCell(row, column, *text);
+	}
+	for (; column < end; ++column)
+	{
+		setCell(row, column, ' ');
+	}
+}
+
+void Display::setIndicator(unsigned int indicator, bool lit)
+{
+	if (indicatorsLit[indicator] == lit)
+	{
+		return;
+	}
+	indicatorsLit[indicator] = lit;
+
+	sf::Vertex* fill = &panel[PANEL_ROWS * PANEL_COLUMNS * 6 + indicator * INDICATOR_VERTICES];
+	for (unsigned int i = 0; i < INDICATOR_SEGMENTS * 3; ++i)
+	{
+		fill[i].color = lit ? sf::Color::Red : sf::Color::Black;
+	}
+}
+
+// a circle like the old sf::CircleShape indicators: radius scale / 2.5 with a 2 pixel white
+// outline outside it, position being the top left of the fill's bounding box
+void Display::buildIndicator(unsigned int indicator, sf::Vector2f position)
+{
+	const float PI = 3.14159265f;
+	float radius = scale / 2.5f;
+	sf::Vector2f center(position.x + radius, position.y + radius);
+	// the font page keeps a white pixel at (1, 1) for underlines, so solid shapes can share its texture
+	sf::Vector2f white(1.0f, 1.0f);
+
+	sf::Vertex* fill = &panel[PANEL_ROWS * PANEL_COLUMNS * 6 + indicator * INDICATOR_VERTICES];
+	sf::Vertex* outline = fill + INDICATOR_SEGMENTS * 3;
+	for (unsigned int i = 0; i < INDICATOR_SEGMENTS; ++i)
+	{
+		float a0 = 2 * PI * i / INDICATOR_SEGMENTS;
+		float a1 = 2 * PI * (i + 1) / INDICATOR_SEGMENTS;
+		sf::Vector2f inner0(center.x + radius * std::cos(a0), center.y + radius * std::sin(a0));
+		sf::Vector2f inner1(center.x + radius * std::cos(a1), center.y + radius * std::sin(a1));
+		sf::Vector2f outer0(center.x + (radius + 2) * std::cos(a0), center.y + (radius + 2) * std::sin(a0));
+		sf::Vector2f outer1(center.x + (radius + 2) * std::cos(a1), center.y + (radius + 2) * std::sin(a1));
+
+		sf::Vertex* triangle = fill + i * 3;
+		triangle[0].position = center;
+		triangle[1].position = inner0;
+		triangle[2].position = inner1;
+
+		sf::Vertex* quad = outline + i * 6;
+		quad[0].position = inner0;
+		quad[1].position = outer0;
+		quad[2].position = inner1;
+		quad[3].position = inner1;
+		quad[4].position = outer0;
+		quad[5].position = outer1;
+
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			triangle[j].color = sf::Color::Black;
+			triangle[j].texCoords = white;
+		}
+		for (unsigned int j = 0; j < 6; ++j)
+		{
+			quad[j].color = sf::Color::White;
+			quad[j].texCoords = white;
+		}
 	}
 }
 
@@ -184,6 +301,10 @@ bool Display::processInput(uint8_t* keys)
 				{
 					quit = true;
 				} break;
+				case sf::Keyboard::BackSpace:
+				{
+					rewinding = true;
+				} break;
 				case sf::Keyboard::Key::X:
 				{
 					keys[0] = 1;
@@ -274,6 +395,10 @@ bool Display::processInput(uint8_t* keys)
 				{
 					quit = true;
 				} break;
+				case sf::Keyboard::BackSpace:
+				{
+					rewinding = false;
+				} break;
 				case sf::Keyboard::Key::X:
 				{
 					keys[0] = 0;
@@ -363,356 +488,7 @@ bool Display::processInput(uint8_t* keys)
 	return quit;
 }
 
-std::string Display::Table0()
+bool Display::isRewinding() const
 {
-	return ((*this).*(table0[opcode & 0x000Fu]))();
+	return rewinding;
 }
-
-std::string Display::Table8()
-{
-	return ((*this).*(table8[opcode & 0x000Fu]))();
-}
-
-std::string Display::TableE()
-{
-	return ((*this).*(tableE[opcode & 0x000Fu]))();
-}
-
-std::string Display::TableF()
-{
-	return ((*this).*(tableF[opcode & 0x00FFu]))();
-}
-
-// Do nothing
-std::string Display::OP_NULL() { return ""; }
-// CLS
-std::string Display::OP_00E0()
-{
-	return "CLS";
-}
-// RET
-std::string Display::OP_00EE()
-{
-	return "RET";
-}
-// JP address
-std::string Display::OP_1nnn()
-{
-	uint16_t addr = (opcode & 0x0FFF);
-	std::stringstream stream;
-	stream << "JP 0x" << std::setw(3) << std::setfill('0') << std::hex << (int)addr;
-	return stream.str();
-}
-
-// CALL address
-std::string Display::OP_2nnn()
-{
-	uint16_t addr = (opcode & 0x0FFF);
-	std::stringstream stream;
-	stream << "CALL 0x" << std::setw(3) << std::setfill('0') << std::hex << (int)addr;
-	return stream.str();
-}
-// SE Vx, byte
-std::string Display::OP_3xkk()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t byte = (opcode & 0x00FF);
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SE V" << std::hex << (int)Vx;
-	stream << ", " << std::setw(2) << std::setfill('0') << std::hex << (int)byte;
-	return stream.str();
-}
-// SNE Vx, byte
-std::string Display::OP_4xkk()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t byte = (opcode & 0x00FF);
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SNE V" << std::hex << (int)Vx;
-	stream << ", " << std::setw(2) << std::setfill('0') << std::hex << (int)byte;
-	return stream.str();
-}
-// SE Vx, Vy
-std::string Display::OP_5xy0()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SE V" << std::hex << (int)Vx;
-	stream << ", V" << std::hex << (int)Vy;
-	return stream.str();
-}
-// LD Vx, byte
-std::string Display::OP_6xkk()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	uint8_t byte = (opcode & 0x00FF);
-	std::stringstream stream;
-	stream << "LD V" << std::hex << (int)Vx;
-	stream << ", " << std::setw(2) << std::setfill('0') << std::hex << (int)byte;
-	return stream.str();
-}
-// ADD Vx, byte
-std::string Display::OP_7xkk()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t byte = (opcode & 0x00FF);
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "ADD V" << std::hex << (int)Vx;
-	stream << ", " << std::setw(2) << std::setfill('0') << std::hex << (int)byte;
-	return stream.str();
-}
-// LD Vx, Vy
-std::string Display::OP_8xy0()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "LD V" << std::hex << (int)Vx;
-	stream << ", V" << std::setw(1) << std::setfill('0') << std::hex << (int)Vy;
-	return stream.str();
-}
-// OR Vx, Vy
-std::string Display::OP_8xy1()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "OR V" << std::hex << (int)Vx;
-	stream << ", V" << std::setw(1) << std::setfill('0') << std::hex << (int)Vy;
-	return stream.str();
-}
-// AND Vx, Vy
-std::string Display::OP_8xy2()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "AND V" << std::hex << (int)Vx;
-	stream << ", V" << std::setw(1) << std::setfill('0') << std::hex << (int)Vy;
-	return stream.str();
-}
-// XOR Vx, Vy
-std::string Display::OP_8xy3()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "XOR V" << std::hex << (int)Vx;
-	stream << ", V" << std::hex << (int)Vy;
-	return stream.str();
-}
-// ADD Vx, Vy
-std::string Display::OP_8xy4()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "ADD V" << std::hex << (int)Vx;
-	stream << ", V" << std::hex << (int)Vy;
-	return stream.str();
-}
-// SUB Vx, Vy
-std::string Display::OP_8xy5()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SUB V" << std::hex << (int)Vx;
-	stream << ", V" << std::hex << (int)Vy;
-	return stream.str();
-}
-// SHR Vx
-std::string Display::OP_8xy6()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SHR V" << std::hex << (int)Vx;
-	return stream.str();
-}
-// SUBN Vx, Vy
-std::string Display::OP_8xy7()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SUBN V" << std::hex << (int)Vx;
-	stream << ", V" << std::hex << (int)Vy;
-	return stream.str();
-}
-// SHL Vx
-std::string Display::OP_8xyE()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SHL V" << std::hex << (int)Vx;
-	return stream.str();
-}
-// SNE Vx, Vy
-std::string Display::OP_9xy0()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SNE V" << std::hex << (int)Vx;
-	stream << ", V" << std::hex << (int)Vy;
-	return stream.str();
-}
-// LD I, address
-std::string Display::OP_Annn()
-{
-	uint16_t addr = (opcode & 0x0FFF);
-	std::stringstream stream;
-	stream << "LD " << std::hex << (int)index;
-	stream << ", 0x" << std::setw(3) << std::setfill('0') << std::hex << (int)addr;
-	return stream.str();
-}
-// JP V0, address
-std::string Display::OP_Bnnn()
-{
-	uint16_t addr = (opcode & 0x0FFF);
-	std::stringstream stream;
-	stream << "JP V0, " << std::setw(3) << std::setfill('0') << std::hex << (int)addr;
-	return stream.str();
-}
-// RND Vx, byte
-std::string Display::OP_Cxkk()
-{
-	uint8_t Vx = (opcode & 0x0F00);
-	uint8_t byte = (opcode & 0x00FF);
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "RND V" << std::hex << (int)Vx;
-	stream << ", " << std::setw(2) << std::setfill('0') << std::hex << (int)byte;
-	return stream.str();
-}
-// DRW Vx, Vy, height
-std::string Display::OP_Dxyn()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	uint8_t Vy = (opcode & 0x00F0) >> 4u;
-	uint8_t height = (opcode & 0x000F);
-	std::stringstream stream;
-	stream << "DRW V" << std::hex << (int)Vx;
-	stream << ", V" << std::hex << (int)Vy;
-	stream << ", " << (int)height;
-	return stream.str();
-}
-// SKP Vx
-std::string Display::OP_Ex9E()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	//registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SKP V" << std::hex << (int)Vx;
-	return stream.str();
-}
-// SKNP Vx
-std::string Display::OP_ExA1()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	//registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "SKNP V" << std::hex << (int)Vx;
-	return stream.str();
-}
-// LD Vx, DT
-std::string Display::OP_Fx07()
-{
-
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "LD V" << std::hex << (int)Vx;
-	stream << ", " << delayTimer;
-	return stream.str();
-}
-// LD Vx, K
-std::string Display::OP_Fx0A()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "LD V" << std::hex << (int)Vx;
-	stream << ", K";
-	return stream.str();
-}
-// LD DT, Vx
-std::string Display::OP_Fx15()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	std::stringstream stream;
-	stream << "LD " << std::setw(2) << std::setfill('0') << std::hex << (int)delayTimer;
-	stream << ", V" << std::hex << (int)Vx;
-	return stream.str();
-}
-// LD ST, Vx
-std::string Display::OP_Fx18()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	std::stringstream stream;
-	stream << "LD ST";
-	stream << ", V" << std::hex << (int)Vx;
-	return stream.str();
-}
-// ADD I, Vx
-std::string Display::OP_Fx1E()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	std::stringstream stream;
-	stream << "ADD " << std::setw(3) << std::setfill('0') << std::hex << (int)index;
-	stream << ", V" << (int)Vx;
-	return stream.str();
-}
-// LD F, Vx
-std::string Display::OP_Fx29()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	std::stringstream stream;
-	stream << "LD F";
-	stream << ", V" << std::hex << (int)Vx;
-	return stream.str();
-}
-// LD B, Vx
-std::string Display::OP_Fx33()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	std::stringstream stream;
-	stream << "LD B";
-	stream << ", V" << std::hex << (int)Vx;
-	return stream.str();
-}
-// LD [I], Vx
-std::string Display::OP_Fx55()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	std::stringstream stream;
-	stream << "LD 0x" << std::setw(3) << std::setfill('0') << std::hex << (int)index;
-	stream << ", V" << std::hex << (int)Vx;
-	return stream.str();
-}
-// LD Vx, [I]
-std::string Display::OP_Fx65()
-{
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
-	registerIndicators[(int)Vx].setFillColor(sf::Color::Red);
-	std::stringstream stream;
-	stream << "LD V" << std::hex << (int)Vx;
-	stream << ", 0x" << std::setw(3) << std::setfill('0') << std::hex << (int)index;
-	return stream.str();
-}
\ No newline at end of file
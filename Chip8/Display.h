@@ -1,108 +1,62 @@
 #pragma once
+#include "Disassembler.h"
+#include "Pixels.h"
 #include <SFML/Graphics.hpp>
 
+const unsigned int LISTING_LINES = 21;	//instructions shown around pc, pc in the middle
+
 class Display
 {
 public:
-	Display(const char* name, int texW, int texH, float windowScale);
-	void updateDisplay(const uint8_t* video, const uint16_t opcode, const uint16_t pc, const uint16_t i,
-		const uint8_t sp, const uint8_t dt, const uint8_t* registers, const uint16_t* stack);
+	// panelRefreshRate: times per second the debug panel is redrawn with new values; 0 leaves the panel
+	// out entirely (no font, narrower window); palette: the colours lit and unlit pixels are drawn in
+	Display(const char* name, int texW, int texH, float windowScale, unsigned int panelRefreshRate,
+		const Palette& palette = DEFAULT_PALETTE);
+	// dirtyRows: rows of video changed since the last call (bit n = row n); 0 skips presenting entirely
+	// listing: LISTING_LINES lines of DISASSEMBLY_LINE_LENGTH around pc, from Disassembler::window
+	void updateDisplay(const uint8_t* video, const uint32_t dirtyRows, const uint16_t opcode, const uint16_t pc,
+		const uint16_t i, const uint8_t sp, const uint8_t dt, const uint8_t* registers, const uint16_t* stack,
+		const char* listing);
 	bool processInput(uint8_t* keys);
+	// the rewind key (Backspace) is held down
+	bool isRewinding() const;
 	
 private:
-	uint16_t opcode;
-	uint16_t index;
-	uint8_t delayTimer;
+	// debug panel layout, in character cells of the panel font
+	static const unsigned int PANEL_ROWS = 23;
+	static const unsigned int PANEL_COLUMNS = 58;
+	static const unsigned int LISTING_COLUMN = 25;	//listing to the right of the registers
+	static const unsigned int INDICATOR_SEGMENTS = 16;	//sides of each indicator circle
+	static const unsigned int INDICATOR_VERTICES = INDICATOR_SEGMENTS * 9;	//fill triangles, then outline quads
+
 	sf::RenderWindow window;
 	sf::Texture texture;
 	sf::Sprite sprite;
 	sf::Uint8* pixels = new sf::Uint8[64 * 32 * 4]{};
+	Palette palette;
 	sf::Font font;
-	sf::CircleShape registerIndicators[16];
-	sf::CircleShape stackIndicators[16];
 	unsigned int scale;
+	unsigned int panelRefreshRate;
+	bool panelReady = false;	//font loaded and vertices built, done on the first refresh
+	sf::Clock panelClock;	//time since the last refresh
+	bool rewinding = false;
 
-	std::string Table0();
-	std::string Table8();
-	std::string TableE();
-	std::string TableF();
+	// the whole panel (text cells, then 16 register and 16 stack indicators) is one vertex array
+	// textured with the font's glyph page, so it draws in a single call; vertices are only
+	// rewritten for the cells and indicators whose contents changed since the last frame
+	sf::VertexArray panel;
+	sf::Glyph glyphs[128];	//printable ASCII at the panel's size, looked up once
+	float cellWidth = 0;
+	float lineHeight = 0;
+	char cells[PANEL_ROWS][PANEL_COLUMNS];	//what the text vertices show now
+	bool indicatorsLit[32]{};
 
-	// Do nothing
-	std::string OP_NULL();
-	// CLS
-	std::string OP_00E0();
-	// RET
-	std::string OP_00EE();
-	// JP address
-	std::string OP_1nnn();
-	// CALL address
-	std::string OP_2nnn();
-	// SE Vx, byte
-	std::string OP_3xkk();
-	// SNE Vx, byte
-	std::string OP_4xkk();
-	// SE Vx, Vy
-	std::string OP_5xy0();
-	// LD Vx, byte
-	std::string OP_6xkk();
-	// ADD Vx, byte
-	std::string OP_7xkk();
-	// LD Vx, Vy
-	std::string OP_8xy0();
-	// OR Vx, Vy
-	std::string OP_8xy1();
-	// AND Vx, Vy
-	std::string OP_8xy2();
-	// XOR Vx, Vy
-	std::string OP_8xy3();
-	// ADD Vx, Vy
-	std::string OP_8xy4();
-	// SUB Vx, Vy
-	std::string OP_8xy5();
-	// SHR Vx
-	std::string OP_8xy6();
-	// SUBN Vx, Vy
-	std::string OP_8xy7();
-	// SHL Vx
-	std::string OP_8xyE();
-	// SNE Vx, Vy
-	std::string OP_9xy0();
-	// LD I, address
-	std::string OP_Annn();
-	// JP V0, address
-	std::string OP_Bnnn();
-	// RND Vx, byte
-	std::string OP_Cxkk();
-	// DRW Vx, Vy, height
-	std::string OP_Dxyn();
-	// SKP Vx
-	std::string OP_Ex9E();
-	// SKNP Vx
-	std::string OP_ExA1();
-	// LD Vx, DT
-	std::string OP_Fx07();
-	// LD Vx, K
-	std::string OP_Fx0A();
-	// LD DT, Vx
-	std::string OP_Fx15();
-	// LD ST, Vx
-	std::string OP_Fx18();
-	// ADD I, Vx
-	std::string OP_Fx1E();
-	// LD F, Vx
-	std::string OP_Fx29();
-	// LD B, Vx
-	std::string OP_Fx33();
-	// LD [I], Vx
-	std::string OP_Fx55();
-	// LD Vx, [I]
-	std::string OP_Fx65();
-
-	typedef std::string (Display::* OpRef)();
-	OpRef table[0xF + 1]{ &Display::OP_NULL };
-	OpRef table0[0xE + 1]{ &Display::OP_NULL };
-	OpRef table8[0xE + 1]{ &Display::OP_NULL };
-	OpRef tableE[0xE + 1]{ &Display::OP_NULL };
-	OpRef tableF[0x65 + 1]{ &Display::OP_NULL };
+	void initPanel();
+	void updatePanel(const uint16_t opcode, const uint16_t pc, const uint16_t index, const uint8_t sp,
+		const uint8_t* registers, const uint16_t* stack, const char* listing);
+	void setCell(unsigned int row, unsigned int column, char c);
+	// text from column on, padded with spaces up to end
+	void setText(unsigned int row, unsigned int column, unsigned int end, const char* text);
+	void setIndicator(unsigned int indicator, bool lit);
+	void buildIndicator(unsigned int indicator, sf::Vector2f position);
 };
-
@@ -0,0 +1,517 @@
+#include "Jit.h"
+#include "Chip8.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_X64
+#endif
+
+#ifdef CHIP8_JIT_X64
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+const size_t CODE_BUFFER_SIZE = 1 << 20;
+const size_t MAX_BLOCK_BYTES = 4096;	//worst case for one block, checked before translating
+const unsigned int MAX_BLOCK_LENGTH = 64;
+
+// x86-64 register numbers
+const unsigned int RAX = 0;
+const unsigned int RCX = 1;
+const unsigned int RDI = 7;	//holds the Chip8 object inside a block
+
+// host registers that can hold guest V registers for the length of a block
+// all caller-saved on System V; rsi is callee-saved on Windows and gets pushed there
+const unsigned int HOST_REGISTERS[] = { 2, 6, 8, 9, 10, 11 };	//dl, sil, r8b, r9b, r10b, r11b
+const unsigned int HOST_REGISTER_COUNT = sizeof(HOST_REGISTERS) / sizeof(HOST_REGISTERS[0]);
+const uint8_t UNASSIGNED = 0xFF;
+
+// opcode bytes for "op r/m8, r8"; the same op with an immediate (0x80) has opcode >> 3 as its /digit
+const uint8_t ALU_ADD = 0x00;
+const uint8_t ALU_OR = 0x08;
+const uint8_t ALU_AND = 0x20;
+const uint8_t ALU_SUB = 0x28;
+const uint8_t ALU_XOR = 0x30;
+const uint8_t ALU_CMP = 0x38;
+
+// condition codes for setcc
+const uint8_t CC_B = 0x2;	//carry
+const uint8_t CC_E = 0x4;
+const uint8_t CC_NE = 0x5;
+const uint8_t CC_A = 0x7;	//unsigned greater
+
+// which guest registers an instruction touches, and whether it can be translated at all
+struct OpInfo
+{
+	bool translatable;
+	bool terminator;	//jump or skip: ends the block and sets pc itself
+	uint8_t regs[3];
+	uint8_t regCount;
+};
+
+static OpInfo classify(const Instruction& ins)
+{
+	uint8_t x = ins.x;
+	uint8_t y = ins.y;
+	OpInfo info{};
+
+	switch (ins.kind)
+	{
+	case OpKind::Op1nnn:
+		info = { true, true, {}, 0 };
+		break;
+	case OpKind::Op3xkk:
+	case OpKind::Op4xkk:
+		info = { true, true, { x }, 1 };
+		break;
+	case OpKind::Op5xy0:
+	case OpKind::Op9xy0:
+		info = { true, true, { x, y }, 2 };
+		break;
+	case OpKind::Op6xkk:
+	case OpKind::Op7xkk:
+		info = { true, false, { x }, 1 };
+		break;
+	case OpKind::Op8xy0:
+	case OpKind::Op8xy1:
+	case OpKind::Op8xy2:
+	case OpKind::Op8xy3:
+		info = { true, false, { x, y }, 2 };
+		break;
+	case OpKind::Op8xy4:
+	case OpKind::Op8xy5:
+	case OpKind::Op8xy7:
+		info = { true, false, { x, y, 0xF }, 3 };
+		break;
+	case OpKind::Op8xy6:
+	case OpKind::Op8xyE:
+		info = { true, false, { x, 0xF }, 2 };
+		break;
+	case OpKind::OpAnnn:
+		info = { true, false, {}, 0 };
+		break;
+	case OpKind::OpFx1E:
+	case OpKind::OpFx29:
+		info = { true, false, { x }, 1 };
+		break;
+	default:
+		break;
+	}
+	return info;
+}
+
+Jit::Jit(Chip8& chip8)
+	: chip8(chip8)
+{
+	uint8_t* base = reinterpret_cast<uint8_t*>(&chip8);
+	registersOffset = static_cast<int32_t>(chip8.registers - base);
+	pcOffset = static_cast<int32_t>(reinterpret_cast<uint8_t*>(&chip8.pc) - base);
+	indexOffset = static_cast<int32_t>(reinterpret_cast<uint8_t*>(&chip8.index) - base);
+
+#ifdef CHIP8_JIT_X64
+#ifdef _WIN32
+	code = static_cast<uint8_t*>(VirtualAlloc(nullptr, CODE_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#else
+	void* buffer = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	code = buffer == MAP_FAILED ? nullptr : static_cast<uint8_t*>(buffer);
+#endif
+#endif
+
+	blocks = std::make_unique<Block[]>(MEMORY_SIZE);
+	covered = std::make_unique<bool[]>(MEMORY_SIZE);
+}
+
+Jit::~Jit()
+{
+#ifdef CHIP8_JIT_X64
+	if (code)
+	{
+#ifdef _WIN32
+		VirtualFree(code, 0, MEM_RELEASE);
+#else
+		munmap(code, CODE_BUFFER_SIZE);
+#endif
+	}
+#endif
+}
+
+bool Jit::isAvailable() const
+{
+	return code != nullptr;
+}
+
+unsigned int Jit::execute(unsigned int budget)
+{
+	uint16_t pc = chip8.pc;
+	if (pc > MEMORY_SIZE - 2)
+	{
+		return 0;
+	}
+
+	Block& block = blocks[pc];
+	if (!block.translated)
+	{
+		translate(pc);
+	}
+	//blocks can't stop part way, so let the interpreter finish off a budget that's too small
+	if (block.length == 0 || block.length > budget)
+	{
+		return 0;
+	}
+
+	chip8.opcode = block.lastOpcode;
+	return block.code(reinterpret_cast<uint8_t*>(&chip8));
+}
+
+void Jit::invalidate(unsigned int address, unsigned int length)
+{
+	unsigned int last = address + length < MEMORY_SIZE ? address + length : MEMORY_SIZE;
+	for (unsigned int i = address; i < last; ++i)
+	{
+		//self-modifying code is rare enough that starting over beats tracking which blocks overlap
+		if (covered[i])
+		{
+			flush();
+			return;
+		}
+	}
+}
+
+void Jit::flush()
+{
+	codeSize = 0;
+	memset(blocks.get(), 0, MEMORY_SIZE * sizeof(Block));
+	memset(covered.get(), 0, MEMORY_SIZE * sizeof(bool));
+}
+
+void Jit::translate(uint16_t address)
+{
+	if (CODE_BUFFER_SIZE - codeSize < MAX_BLOCK_BYTES)
+	{
+		flush();
+	}
+
+	//first pass: find where the block ends and give each guest register it uses a host register
+	uint16_t opcodes[MAX_BLOCK_LENGTH];
+	uint8_t host[REGISTER_COUNT];
+	memset(host, UNASSIGNED, sizeof(host));
+	unsigned int hostUsed = 0;
+	unsigned int length = 0;
+	bool terminated = false;
+	uint16_t end = address;
+
+	while (length < MAX_BLOCK_LENGTH && end <= MEMORY_SIZE - 2)
+	{
+		uint16_t opcode = (chip8.memory[end] << 8u) | chip8.memory[end + 1];
+		OpInfo info = classify(decode(opcode));
+		if (!info.translatable)
+		{
+			break;
+		}
+
+		unsigned int needed = 0;
+		for (unsigned int i = 0; i < info.regCount; ++i)
+		{
+			bool seen = host[info.regs[i]] != UNASSIGNED;
+			for (unsigned int j = 0; j < i; ++j)
+			{
+				seen = seen || info.regs[j] == info.regs[i];
+			}
+			needed += seen ? 0 : 1;
+		}
+		if (hostUsed + needed > HOST_REGISTER_COUNT)
+		{
+			break;
+		}
+		for (unsigned int i = 0; i < info.regCount; ++i)
+		{
+			if (host[info.regs[i]] == UNASSIGNED)
+			{
+				host[info.regs[i]] = HOST_REGISTERS[hostUsed++];
+			}
+		}
+
+		opcodes[length++] = opcode;
+		end += 2;
+		if (info.terminator)
+		{
+			terminated = true;
+			break;
+		}
+	}
+
+	Block& block = blocks[address];
+	block.translated = true;
+	block.length = static_cast<uint16_t>(length);
+	//untranslatable addresses are covered too, so a rewrite there gets another look
+	covered[address] = true;
+	covered[address + 1] = true;
+	if (length == 0)
+	{
+		return;
+	}
+	for (uint16_t i = address; i < end; ++i)
+	{
+		covered[i] = true;
+	}
+
+	//second pass: emit
+	block.code = reinterpret_cast<BlockFn>(code + codeSize);
+	block.lastOpcode = opcodes[length - 1];
+
+#ifdef _WIN32
+	emit8(0x57);	//push rdi
+	emit8(0x56);	//push rsi
+	emit8(0x48); emit8(0x89); emit8(0xCF);	//mov rdi, rcx
+#endif
+	for (unsigned int v = 0; v < REGISTER_COUNT; ++v)
+	{
+		if (host[v] != UNASSIGNED)
+		{
+			emitLoad8(host[v], registersOffset + v);
+		}
+	}
+
+	uint16_t next = address;
+	for (unsigned int i = 0; i < length; ++i)
+	{
+		Instruction ins = decode(opcodes[i]);
+		uint8_t kk = ins.kk;
+		uint16_t nnn = ins.nnn;
+		unsigned int hx = host[ins.x];
+		unsigned int hy = host[ins.y];
+		unsigned int hf = host[0xF];
+		next += 2;
+
+		//flag-setting ops follow the interpreter's order of reads and writes exactly,
+		//so aliasing x or y with VF gives the same result
+		switch (ins.kind)
+		{
+		case OpKind::Op1nnn:
+			emitStoreWordImm(pcOffset, nnn);
+			break;
+		case OpKind::Op3xkk:
+			emitAluImm8(ALU_CMP, hx, kk);
+			emitSkip(CC_E, next);
+			break;
+		case OpKind::Op4xkk:
+			emitAluImm8(ALU_CMP, hx, kk);
+			emitSkip(CC_NE, next);
+			break;
+		case OpKind::Op5xy0:
+			emitAlu8(ALU_CMP, hx, hy);
+			emitSkip(CC_E, next);
+			break;
+		case OpKind::Op9xy0:
+			emitAlu8(ALU_CMP, hx, hy);
+			emitSkip(CC_NE, next);
+			break;
+		case OpKind::Op6xkk:
+			emitMovImm8(hx, kk);
+			break;
+		case OpKind::Op7xkk:
+			emitAluImm8(ALU_ADD, hx, kk);
+			break;
+		case OpKind::OpAnnn:
+			emitStoreWordImm(indexOffset, nnn);
+			break;
+		case OpKind::Op8xy0:
+			emitMov8(hx, hy);
+			break;
+		case OpKind::Op8xy1:
+			emitAlu8(ALU_OR, hx, hy);
+			break;
+		case OpKind::Op8xy2:
+			emitAlu8(ALU_AND, hx, hy);
+			break;
+		case OpKind::Op8xy3:
+			emitAlu8(ALU_XOR, hx, hy);
+			break;
+		case OpKind::Op8xy4:
+			emitMov8(RAX, hx);
+			emitAlu8(ALU_ADD, RAX, hy);
+			emitSetcc(CC_B, RCX);
+			emitMov8(hf, RCX);
+			emitMov8(hx, RAX);
+			break;
+		case OpKind::Op8xy5:
+			emitMov8(RAX, hx);
+			emitAlu8(ALU_CMP, RAX, hy);
+			emitSetcc(CC_A, RCX);
+			emitMov8(hf, RCX);
+			emitAlu8(ALU_SUB, hx, hy);
+			break;
+		case OpKind::Op8xy6:
+			emitMov8(RAX, hx);
+			emitAluImm8(ALU_AND, RAX, 0x1);
+			emitMov8(hf, RAX);
+			emitShift8(5, hx, 1);	//shr
+			break;
+		case OpKind::Op8xy7:
+			emitMov8(RAX, hy);
+			emitAlu8(ALU_CMP, RAX, hx);
+			emitSetcc(CC_A, RCX);
+			emitMov8(hf, RCX);
+			emitMov8(RAX, hy);
+			emitAlu8(ALU_SUB, RAX, hx);
+			emitMov8(hx, RAX);
+			break;
+		case OpKind::Op8xyE:
+			emitMov8(RAX, hx);
+			emitShift8(5, RAX, 7);	//shr
+			emitMov8(hf, RAX);
+			emitShift8(4, hx, 1);	//shl
+			break;
+		case OpKind::OpFx1E:
+		case OpKind::OpFx29:
+			//movzx eax, Vx
+			emitRex(RAX, hx);
+			emit8(0x0F); emit8(0xB6); emit8(0xC0 | (hx & 7));
+			if (ins.kind == OpKind::OpFx1E)
+			{
+				//add word [rdi + index], ax
+				emit8(0x66); emit8(0x01); emit8(0x87); emit32(indexOffset);
+			}
+			else
+			{
+				emit8(0x8D); emit8(0x04); emit8(0x80);	//lea eax, [rax + rax * 4]
+				emit8(0x05); emit32(FONTSET_START_ADDRESS);	//add eax, imm32
+				emit8(0x66); emit8(0x89); emit8(0x87); emit32(indexOffset);	//mov word [rdi + index], ax
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	for (unsigned int v = 0; v < REGISTER_COUNT; ++v)
+	{
+		if (host[v] != UNASSIGNED)
+		{
+			emitStore8(host[v], registersOffset + v);
+		}
+	}
+	if (!terminated)
+	{
+		emitStoreWordImm(pcOffset, next);
+	}
+
+	emit8(0xB8); emit32(length);	//mov eax, length
+#ifdef _WIN32
+	emit8(0x5E);	//pop rsi
+	emit8(0x5F);	//pop rdi
+#endif
+	emit8(0xC3);	//ret
+}
+
+void Jit::emit8(uint8_t byte)
+{
+	code[codeSize++] = byte;
+}
+
+void Jit::emit16(uint16_t value)
+{
+	emit8(value & 0xFFu);
+	emit8(value >> 8u);
+}
+
+void Jit::emit32(uint32_t value)
+{
+	emit16(value & 0xFFFFu);
+	emit16(value >> 16u);
+}
+
+//always emitted for byte ops so sil and r8b-r11b encode, and so dl never means dh
+void Jit::emitRex(unsigned int reg, unsigned int rm)
+{
+	emit8(0x40 | ((reg & 8) ? 0x4 : 0) | ((rm & 8) ? 0x1 : 0));
+}
+
+//mov reg8, byte [rdi + offset]
+void Jit::emitLoad8(unsigned int reg, int32_t offset)
+{
+	emitRex(reg, RDI);
+	emit8(0x8A);
+	emit8(0x80 | ((reg & 7) << 3) | RDI);
+	emit32(offset);
+}
+
+//mov byte [rdi + offset], reg8
+void Jit::emitStore8(unsigned int reg, int32_t offset)
+{
+	emitRex(reg, RDI);
+	emit8(0x88);
+	emit8(0x80 | ((reg & 7) << 3) | RDI);
+	emit32(offset);
+}
+
+void Jit::emitMov8(unsigned int dst, unsigned int src)
+{
+	emitAlu8(0x88, dst, src);
+}
+
+void Jit::emitMovImm8(unsigned int reg, uint8_t imm)
+{
+	emitRex(0, reg);
+	emit8(0xB0 | (reg & 7));
+	emit8(imm);
+}
+
+//op dst8, src8
+void Jit::emitAlu8(uint8_t opcode, unsigned int dst, unsigned int src)
+{
+	emitRex(src, dst);
+	emit8(opcode);
+	emit8(0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+//group 1 op reg8, imm8; opcode is one of the ALU_ constants
+void Jit::emitAluImm8(uint8_t opcode, unsigned int reg, uint8_t imm)
+{
+	emitRex(0, reg);
+	emit8(0x80);
+	//the /digit is opcode >> 3, and opcode & 0x38 is that already shifted into the reg field
+	emit8(0xC0 | (opcode & 0x38) | (reg & 7));
+	emit8(imm);
+}
+
+//group 2 op reg8, imm8: ext 4 = shl, 5 = shr
+void Jit::emitShift8(unsigned int ext, unsigned int reg, uint8_t count)
+{
+	emitRex(0, reg);
+	emit8(0xC0);
+	emit8(0xC0 | (ext << 3) | (reg & 7));
+	emit8(count);
+}
+
+void Jit::emitSetcc(uint8_t condition, unsigned int reg)
+{
+	emitRex(0, reg);
+	emit8(0x0F);
+	emit8(0x90 | condition);
+	emit8(0xC0 | (reg & 7));
+}
+
+//mov word [rdi + offset], imm16
+void Jit::emitStoreWordImm(int32_t offset, uint16_t imm)
+{
+	emit8(0x66);
+	emit8(0xC7);
+	emit8(0x80 | RDI);
+	emit32(offset);
+	emit16(imm);
+}
+
+//pc = next, or next + 2 when condition holds, without a branch
+void Jit::emitSkip(uint8_t condition, uint16_t next)
+{
+	emitSetcc(condition, RCX);
+	emit8(0x0F); emit8(0xB6); emit8(0xC9);	//movzx ecx, cl
+	emit8(0x01); emit8(0xC9);	//add ecx, ecx
+	emit8(0x81); emit8(0xC1); emit32(next);	//add ecx, next
+	emit8(0x66); emit8(0x89); emit8(0x8F); emit32(pcOffset);	//mov word [rdi + pc], cx
+}
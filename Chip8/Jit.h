@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class Chip8;
+
+/*
+	x86-64 basic-block recompiler for Chip8.
+
+	A block is a straight run of ALU/load instructions ending at a jump or skip, or right before
+	anything that isn't translated (Dxyn, Fx0A, calls, timers, keypad, memory stores...), which the
+	interpreter then runs. Guest registers used by a block are loaded into host registers on entry
+	and written back on exit.
+
+	Blocks are thrown away when OP_Fx33/OP_Fx55 (or loadROM) write over memory they were built from.
+*/
+
+class Jit
+{
+public:
+	explicit Jit(Chip8& chip8);
+	~Jit();
+
+	//true when built for x86-64 and executable memory could be allocated
+	bool isAvailable() const;
+
+	//run the block at pc if it has at most budget instructions
+	//returns the number of instructions executed, 0 when the instruction at pc must be interpreted
+	unsigned int execute(unsigned int budget);
+
+	//drop every block built from memory[address, address + length)
+	void invalidate(unsigned int address, unsigned int length);
+
+private:
+	typedef unsigned int (*BlockFn)(uint8_t* base);
+
+	struct Block
+	{
+		BlockFn code;
+		uint16_t length;	//instructions in the block, 0 = interpret
+		uint16_t lastOpcode;
+		bool translated;
+	};
+
+	Chip8& chip8;
+	uint8_t* code = nullptr;	//executable buffer
+	size_t codeSize = 0;
+	std::unique_ptr<Block[]> blocks;	//one per address
+	std::unique_ptr<bool[]> covered;	//addresses some block was built from
+
+	//offsets of guest state from the Chip8 object, used as [base + disp32] in emitted code
+	int32_t registersOffset;
+	int32_t pcOffset;
+	int32_t indexOffset;
+
+	void flush();
+	void translate(uint16_t address);
+
+	void emit8(uint8_t byte);
+	void emit16(uint16_t value);
+	void emit32(uint32_t value);
+	void emitRex(unsigned int reg, unsigned int rm);
+	void emitLoad8(unsigned int reg, int32_t offset);
+	void emitStore8(unsigned int reg, int32_t offset);
+	void emitMov8(unsigned int dst, unsigned int src);
+	void emitMovImm8(unsigned int reg, uint8_t imm);
+	void emitAlu8(uint8_t opcode, unsigned int dst, unsigned int src);
+	void emitAluImm8(uint8_t opcode, unsigned int reg, uint8_t imm);
+	void emitShift8(unsigned int ext, unsigned int reg, uint8_t count);
+	void emitSetcc(uint8_t condition, unsigned int reg);
+	void emitStoreWordImm(int32_t offset, uint16_t imm);
+	void emitSkip(uint8_t condition, uint16_t next);
+};
@@ -0,0 +1,120 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& file)
+{
+	close();
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	fileHandle = handle;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize))
+	{
+		close();
+		return false;
+	}
+	//an empty file can't be mapped, and there is nothing to map
+	if (fileSize.QuadPart == 0)
+	{
+		close();
+		return true;
+	}
+	mappingHandle = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		close();
+		return false;
+	}
+	view = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (view == nullptr)
+	{
+		close();
+		return false;
+	}
+	length = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int descriptor = ::open(file.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+	struct stat status;
+	if (fstat(descriptor, &status) != 0)
+	{
+		::close(descriptor);
+		return false;
+	}
+	//an empty file can't be mapped, and there is nothing to map
+	if (status.st_size == 0)
+	{
+		::close(descriptor);
+		return true;
+	}
+	//the mapping keeps the file referenced, so the descriptor isn't needed past this
+	void* mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	::close(descriptor);
+	if (mapped == MAP_FAILED)
+	{
+		return false;
+	}
+	view = static_cast<const uint8_t*>(mapped);
+	length = static_cast<size_t>(status.st_size);
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (view != nullptr)
+	{
+		UnmapViewOfFile(view);
+	}
+	if (mappingHandle != nullptr)
+	{
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != nullptr)
+	{
+		CloseHandle(fileHandle);
+	}
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (view != nullptr)
+	{
+		munmap(const_cast<uint8_t*>(view), length);
+	}
+#endif
+	view = nullptr;
+	length = 0;
+}
+
+const uint8_t* MappedFile::data() const
+{
+	return view;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
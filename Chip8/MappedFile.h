@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+	A whole file mapped read-only into memory: opening costs a system call or two however big the
+	file is, and pages are only read from disk when touched.
+*/
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//map file, replacing whatever was mapped before; false if it can't be opened
+	//an empty file opens with data() nullptr and size() 0, nothing mapped
+	bool open(const std::string& file);
+	void close();
+
+	const uint8_t* data() const;
+	size_t size() const;
+
+private:
+	const uint8_t* view = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;	//HANDLEs, kept as void* so windows.h stays out of the header
+	void* mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,123 @@
+#include "Movie.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+uint64_t hashImage(const uint8_t* memory)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (unsigned int i = 0; i < MEMORY_SIZE; ++i)
+	{
+		hash ^= memory[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+bool writeMovie(const std::string& file, const Movie& movie)
+{
+	MovieHeader header{};
+	memcpy(header.magic, MOVIE_MAGIC, sizeof(header.magic));
+	header.version = MOVIE_VERSION;
+	header.seed = movie.seed;
+	header.romHash = movie.romHash;
+	header.frames = movie.frames;
+	header.instructionsPerFrame = movie.instructionsPerFrame;
+	header.eventCount = static_cast<uint32_t>(movie.events.size());
+
+	std::vector<uint8_t> records;
+	uint64_t frame = 0;
+	for (const KeyEvent& event : movie.events)
+	{
+		uint64_t delta = event.frame - frame;
+		frame = event.frame;
+		do
+		{
+			uint8_t byte = delta & 0x7F;
+			delta >>= 7;
+			records.push_back(delta != 0 ? byte | 0x80 : byte);
+		} while (delta != 0);
+		records.push_back(static_cast<uint8_t>(event.key | event.state << 4));
+	}
+
+	std::ofstream out(file, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+	{
+		return false;
+	}
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(records.data()), records.size());
+	return out.good();
+}
+
+bool loadMovie(const std::string& file, Movie& movie)
+{
+	std::ifstream in(file, std::ios::binary);
+	if (!in.is_open())
+	{
+		std::cerr << "Could not open movie " << file << std::endl;
+		return false;
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	MovieHeader header;
+	if (data.size() < sizeof(header))
+	{
+		std::cerr << "Not a movie: " << file << std::endl;
+		return false;
+	}
+	memcpy(&header, data.data(), sizeof(header));
+	if (memcmp(header.magic, MOVIE_MAGIC, sizeof(header.magic)) != 0 || header.version != MOVIE_VERSION)
+	{
+		std::cerr << "Not a movie this build can play: " << file << std::endl;
+		return false;
+	}
+	//every event takes at least two bytes, so a count the file can't hold is caught before reserving it
+	if (header.eventCount > (data.size() - sizeof(header)) / 2)
+	{
+		std::cerr << "Movie is cut short: " << file << std::endl;
+		return false;
+	}
+	if (header.instructionsPerFrame == 0)
+	{
+		std::cerr << "Movie has no instructions per frame: " << file << std::endl;
+		return false;
+	}
+
+	movie.seed = header.seed;
+	movie.romHash = header.romHash;
+	movie.frames = header.frames;
+	movie.instructionsPerFrame = header.instructionsPerFrame;
+	movie.events.clear();
+	movie.events.reserve(header.eventCount);
+
+	size_t position = sizeof(header);
+	uint64_t frame = 0;
+	for (uint32_t i = 0; i < header.eventCount; ++i)
+	{
+		uint64_t delta = 0;
+		unsigned int shift = 0;
+		uint8_t byte;
+		do
+		{
+			if (position >= data.size() || shift >= 64)
+			{
+				std::cerr << "Movie is cut short: " << file << std::endl;
+				return false;
+			}
+			byte = data[position++];
+			delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		if (position >= data.size())
+		{
+			std::cerr << "Movie is cut short: " << file << std::endl;
+			return false;
+		}
+		uint8_t change = data[position++];
+		frame += delta;
+		movie.events.push_back({ frame, static_cast<uint8_t>(change & 0x0F), static_cast<uint8_t>(change >> 4 & 1) });
+	}
+	return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Chip8.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const uint32_t MOVIE_VERSION = 1;
+const char MOVIE_MAGIC[4] = { 'C', '8', 'M', 'V' };
+
+// one keypad change, applied at the start of the given frame
+struct KeyEvent
+{
+	uint64_t frame;
+	uint8_t key;
+	uint8_t state;
+};
+
+/*
+	A recorded run. Given the ROM, the random seed, the instructions per frame and the keypad at
+	the start of every frame, a Chip8 always does the same thing, so that is all a movie holds:
+	replaying one, headless or in the window, ends in the same state bit for bit.
+
+	File layout: MovieHeader (little-endian, no padding, checked below), then one record per key
+	change in frame order: the frames since the previous change as an unsigned LEB128 number,
+	then one byte, key | state << 4. A change is usually 2 bytes.
+*/
+
+struct MovieHeader
+{
+	char magic[4];	//MOVIE_MAGIC
+	uint32_t version;	//MOVIE_VERSION
+	uint64_t seed;
+	uint64_t romHash;
+	uint64_t frames;
+	uint32_t instructionsPerFrame;
+	uint32_t eventCount;
+};
+
+static_assert(sizeof(MovieHeader) == 40, "movie header layout changed");
+
+struct Movie
+{
+	uint64_t seed = 0;	//Chip8::setSeed before the first frame
+	uint64_t romHash = 0;	//hashImage of the machine it was recorded on, right after loadROM
+	uint64_t frames = 0;	//length of the recording
+	unsigned int instructionsPerFrame = 0;
+	std::vector<KeyEvent> events;	//in frame order
+};
+
+//FNV-1a of all of memory; taken right after loadROM it identifies the ROM a movie needs
+uint64_t hashImage(const uint8_t* memory);
+
+//false if the file can't be written
+bool writeMovie(const std::string& file, const Movie& movie);
+
+//false, with a message on stderr, if the file can't be read or isn't a movie this build can play
+bool loadMovie(const std::string& file, Movie& movie);
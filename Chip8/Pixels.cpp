@@ -0,0 +1,264 @@
+#include "Pixels.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CHIP8_PIXELS_SIMD
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// GCC/Clang only emit SSE2/AVX2 inside functions marked for it, MSVC takes the intrinsics anywhere.
+// Either way they only run after cpuHas() said so.
+#if defined(__GNUC__)
+#define SSE2_FUNCTION __attribute__((target("sse2")))
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define SSE2_FUNCTION
+#define AVX2_FUNCTION
+#endif
+
+// one row of VIDEO_WIDTH video bytes to VIDEO_WIDTH RGBA pixels; colours are RGBA bytes as loaded
+// from memory, so each kernel picks per pixel with off ^ ((on ^ off) & lit) and never branches
+typedef void (*RowKernel)(const uint8_t* video, uint8_t* out, uint32_t on, uint32_t off);
+
+static void rowScalar(const uint8_t* video, uint8_t* out, uint32_t on, uint32_t off)
+{
+	for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+	{
+		uint32_t lit = video[x] == 0xFF ? 0xFFFFFFFFu : 0u;
+		uint32_t colour = off ^ ((on ^ off) & lit);
+		memcpy(out + x * 4, &colour, sizeof(colour));
+	}
+}
+
+// one row of VIDEO_WIDTH video bytes to VIDEO_WIDTH * scale RGBA pixels, each pixel repeated scale times
+typedef void (*WideKernel)(const uint8_t* video, uint8_t* out, uint32_t on, uint32_t off, unsigned int scale);
+
+// pixels first to the end of the row, one 4-byte store at a time
+static void wideFrom(unsigned int first, const uint8_t* video, uint8_t* out, uint32_t on, uint32_t off, unsigned int scale)
+{
+	out += first * scale * 4;
+	for (unsigned int x = first; x < VIDEO_WIDTH; ++x)
+	{
+		uint32_t colour = off ^ ((on ^ off) & (0u - (video[x] == 0xFF)));
+		for (unsigned int i = 0; i < scale; ++i, out += 4)
+		{
+			memcpy(out, &colour, sizeof(colour));
+		}
+	}
+}
+
+static void wideScalar(const uint8_t* video, uint8_t* out, uint32_t on, uint32_t off, unsigned int scale)
+{
+	wideFrom(0, video, out, on, off, scale);
+}
+
+#ifdef CHIP8_PIXELS_SIMD
+// 16 pixels a step: compare the bytes, then widen each byte of the mask to a whole pixel
+SSE2_FUNCTION static void rowSse2(const uint8_t* video, uint8_t* out, uint32_t on, uint32_t off)
+{
+	const __m128i on8 = _mm_set1_epi8(static_cast<char>(0xFF));
+	const __m128i offColour = _mm_set1_epi32(static_cast<int>(off));
+	const __m128i difference = _mm_set1_epi32(static_cast<int>(on ^ off));
+	for (unsigned int x = 0; x < VIDEO_WIDTH; x += 16)
+	{
+		__m128i lit = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(video + x)), on8);
+		__m128i low = _mm_unpacklo_epi8(lit, lit);
+		__m128i high = _mm_unpackhi_epi8(lit, lit);
+		__m128i masks[4] = { _mm_unpacklo_epi16(low, low), _mm_unpackhi_epi16(low, low),
+			_mm_unpacklo_epi16(high, high), _mm_unpackhi_epi16(high, high) };
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + (x + i * 4) * 4),
+				_mm_xor_si128(offColour, _mm_and_si128(difference, masks[i])));
+		}
+	}
+}
+
+// the same, with the mask bytes sign-extended straight to eight 32-bit pixels at a time
+AVX2_FUNCTION static void rowAvx2(const uint8_t* video, uint8_t* out, uint32_t on, uint32_t off)
+{
+	const __m128i on8 = _mm_set1_epi8(static_cast<char>(0xFF));
+	const __m256i offColour = _mm256_set1_epi32(static_cast<int>(off));
+	const __m256i difference = _mm256_set1_epi32(static_cast<int>(on ^ off));
+	for (unsigned int x = 0; x < VIDEO_WIDTH; x += 16)
+	{
+		__m128i lit = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(video + x)), on8);
+		__m256i first = _mm256_cvtepi8_epi32(lit);
+		__m256i second = _mm256_cvtepi8_epi32(_mm_srli_si128(lit, 8));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4),
+			_mm256_xor_si256(offColour, _mm256_and_si256(difference, first)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (x + 8) * 4),
+			_mm256_xor_si256(offColour, _mm256_and_si256(difference, second)));
+	}
+}
+
+// Scaled: each pixel's colour, picked without a branch, broadcast and stored as whole vectors, rounded up.
+// The round-up spills into the next pixel's run, which that pixel then overwrites; only the last few
+// pixels, whose spill would pass the end of the row, go one by one. Below the vector width the stores
+// would mostly overlap, so 2x pairs colours up with unpacks instead.
+SSE2_FUNCTION static void wideSse2(const uint8_t* video, uint8_t* out, uint32_t on, uint32_t off, unsigned int scale)
+{
+	if (scale == 2)
+	{
+		alignas(16) uint8_t row[VIDEO_WIDTH * 4];
+		rowSse2(video, row, on, off);
+		for (unsigned int x = 0; x < VIDEO_WIDTH; x += 4)
+		{
+			__m128i colours = _mm_load_si128(reinterpret_cast<const __m128i*>(row + x * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 8), _mm_unpacklo_epi32(colours, colours));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 8 + 16), _mm_unpackhi_epi32(colours, colours));
+		}
+		return;
+	}
+
+	unsigned int vectors = (scale + 3) / 4;
+	unsigned int x = 0;
+	for (; x * scale + vectors * 4 <= VIDEO_WIDTH * scale; ++x)
+	{
+		__m128i colour = _mm_set1_epi32(static_cast<int>(off ^ ((on ^ off) & (0u - (video[x] == 0xFF)))));
+		uint8_t* run = out + x * scale * 4;
+		for (unsigned int i = 0; i < vectors; ++i)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(run + i * 16), colour);
+		}
+	}
+	wideFrom(x, video, out, on, off, scale);
+}
+
+AVX2_FUNCTION static void wideAvx2(const uint8_t* video, uint8_t* out, uint32_t on, uint32_t off, unsigned int scale)
+{
+	if (scale < 8)
+	{
+		wideSse2(video, out, on, off, scale);
+		return;
+	}
+
+	unsigned int vectors = (scale + 7) / 8;
+	unsigned int x = 0;
+	for (; x * scale + vectors * 8 <= VIDEO_WIDTH * scale; ++x)
+	{
+		__m256i colour = _mm256_set1_epi32(static_cast<int>(off ^ ((on ^ off) & (0u - (video[x] == 0xFF)))));
+		uint8_t* run = out + x * scale * 4;
+		for (unsigned int i = 0; i < vectors; ++i)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(run + i * 32), colour);
+		}
+	}
+	wideFrom(x, video, out, on, off, scale);
+}
+#endif
+
+static bool cpuHas(PixelKernel kernel)
+{
+	if (kernel == PixelKernel::Scalar)
+	{
+		return true;
+	}
+#if !defined(CHIP8_PIXELS_SIMD)
+	return false;
+#elif defined(__GNUC__)
+	return kernel == PixelKernel::Sse2 ? __builtin_cpu_supports("sse2") : __builtin_cpu_supports("avx2");
+#else
+	int info[4];
+	__cpuid(info, 0);
+	int highest = info[0];
+	__cpuid(info, 1);
+	if (kernel == PixelKernel::Sse2)
+	{
+		return (info[3] & (1 << 26)) != 0;
+	}
+	//AVX2 also needs AVX, and the OS saving the YMM registers
+	if (highest < 7 || (info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+bool isPixelKernelAvailable(PixelKernel kernel)
+{
+	return cpuHas(kernel);
+}
+
+PixelKernel bestPixelKernel()
+{
+	static const PixelKernel best = cpuHas(PixelKernel::Avx2) ? PixelKernel::Avx2
+		: cpuHas(PixelKernel::Sse2) ? PixelKernel::Sse2 : PixelKernel::Scalar;
+	return best;
+}
+
+static WideKernel wideKernel(PixelKernel kernel)
+{
+#ifdef CHIP8_PIXELS_SIMD
+	if (kernel == PixelKernel::Avx2)
+	{
+		return wideAvx2;
+	}
+	if (kernel == PixelKernel::Sse2)
+	{
+		return wideSse2;
+	}
+#endif
+	return wideScalar;
+}
+
+static RowKernel rowKernel(PixelKernel kernel)
+{
+#ifdef CHIP8_PIXELS_SIMD
+	if (kernel == PixelKernel::Avx2)
+	{
+		return rowAvx2;
+	}
+	if (kernel == PixelKernel::Sse2)
+	{
+		return rowSse2;
+	}
+#endif
+	return rowScalar;
+}
+
+void videoToRGBA(const uint8_t* video, uint8_t* pixels, unsigned int firstRow, unsigned int rows,
+	const Palette& palette, unsigned int scale)
+{
+	videoToRGBA(bestPixelKernel(), video, pixels, firstRow, rows, palette, scale);
+}
+
+void videoToRGBA(PixelKernel kernel, const uint8_t* video, uint8_t* pixels, unsigned int firstRow, unsigned int rows,
+	const Palette& palette, unsigned int scale)
+{
+	//the wide kernels step by scale, so they'd never finish at 0
+	if (scale == 0)
+	{
+		return;
+	}
+
+	RowKernel expand = rowKernel(kernel);
+	WideKernel widen = wideKernel(kernel);
+	uint32_t on;
+	uint32_t off;
+	memcpy(&on, palette.on, sizeof(on));
+	memcpy(&off, palette.off, sizeof(off));
+
+	size_t rowBytes = static_cast<size_t>(VIDEO_WIDTH) * scale * 4;
+	for (unsigned int y = firstRow; y < firstRow + rows; ++y)
+	{
+		uint8_t* out = pixels + y * scale * rowBytes;
+		if (scale == 1)
+		{
+			expand(video + y * VIDEO_WIDTH, out, on, off);
+			continue;
+		}
+
+		//scaled: one widened row, then copies of it downwards
+		widen(video + y * VIDEO_WIDTH, out, on, off, scale);
+		for (unsigned int i = 1; i < scale; ++i)
+		{
+			memcpy(out + i * rowBytes, out, rowBytes);
+		}
+	}
+}
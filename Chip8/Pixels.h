@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Chip8.h"
+#include <cstdint>
+
+//the two colours video is shown in, as RGBA bytes
+struct Palette
+{
+	uint8_t on[4];
+	uint8_t off[4];
+};
+
+const Palette DEFAULT_PALETTE = { { 0xFF, 0xFF, 0xFF, 0xFF }, { 0x00, 0x00, 0x00, 0xFF } };	//white on black
+
+//the ways videoToRGBA can run; SSE2 and AVX2 only on x86 CPUs that have them
+enum class PixelKernel
+{
+	Scalar,
+	Sse2,
+	Avx2
+};
+
+//false when this build or CPU can't run kernel
+bool isPixelKernelAvailable(PixelKernel kernel);
+
+//the fastest kernel available, picked once
+PixelKernel bestPixelKernel();
+
+//video rows [firstRow, firstRow + rows) to 4-byte RGBA pixels at the same place in pixels, each video
+//pixel a scale x scale square (pixels is VIDEO_WIDTH * scale by VIDEO_HEIGHT * scale, 4 bytes each):
+//0xFF is palette.on, anything else palette.off. scale is 1 or more; 0 is an empty image and writes nothing
+void videoToRGBA(const uint8_t* video, uint8_t* pixels, unsigned int firstRow, unsigned int rows,
+	const Palette& palette = DEFAULT_PALETTE, unsigned int scale = 1);
+
+//the same with a given kernel, which has to be available; for benchmarks and checking kernels agree
+void videoToRGBA(PixelKernel kernel, const uint8_t* video, uint8_t* pixels, unsigned int firstRow, unsigned int rows,
+	const Palette& palette = DEFAULT_PALETTE, unsigned int scale = 1);
@@ -0,0 +1,136 @@
+//the whole profiler compiles out unless CHIP8_PROFILE is defined, like its hooks in Chip8
+#ifdef CHIP8_PROFILE
+
+#include "Profiler.h"
+#include "Disassembler.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+//same order as OpKind
+static const char* const kindNames[OP_KIND_COUNT] = {
+	"Null", "00E0", "00EE", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk",
+	"7xkk", "8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7",
+	"8xyE", "9xy0", "Annn", "Bnnn", "Cxkk", "Dxyn", "Ex9E", "ExA1", "Fx07",
+	"Fx0A", "Fx15", "Fx18", "Fx1E", "Fx29", "Fx33", "Fx55", "Fx65"
+};
+
+Profiler::Profiler()
+{
+	reset();
+}
+
+void Profiler::reset()
+{
+	instructions = 0;
+	memset(kindCounts, 0, sizeof(kindCounts));
+	memset(kindNanoseconds, 0, sizeof(kindNanoseconds));
+	memset(pcCounts, 0, sizeof(pcCounts));
+}
+
+const char* Profiler::kindName(OpKind kind)
+{
+	return kindNames[static_cast<size_t>(kind)];
+}
+
+// the executed entries of counts[0, size), hottest first, ties in index order
+static std::vector<unsigned int> hottest(const uint64_t* counts, unsigned int size)
+{
+	std::vector<unsigned int> order;
+	for (unsigned int i = 0; i < size; ++i)
+	{
+		if (counts[i] > 0)
+		{
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[counts](unsigned int a, unsigned int b) { return counts[a] > counts[b]; });
+	return order;
+}
+
+bool Profiler::writeJson(const std::string& file, const uint8_t* memory) const
+{
+	std::ofstream out(file, std::ios::trunc);
+	if (!out.is_open())
+	{
+		return false;
+	}
+	double total = instructions > 0 ? static_cast<double>(instructions) : 1.0;
+
+	out << "{\n  \"instructions\": " << instructions << ",\n  \"kinds\": [";
+	const char* separator = "\n";
+	for (unsigned int kind : hottest(kindCounts, OP_KIND_COUNT))
+	{
+		out << separator << "    { \"kind\": \"" << kindNames[kind] << "\", \"count\": " << kindCounts[kind]
+			<< ", \"share\": " << std::fixed << std::setprecision(6) << kindCounts[kind] / total;
+		if (isTimed(static_cast<OpKind>(kind)))
+		{
+			out << ", \"nanoseconds\": " << kindNanoseconds[kind] << ", \"nanosecondsPerCall\": "
+				<< std::setprecision(1) << static_cast<double>(kindNanoseconds[kind]) / kindCounts[kind];
+		}
+		out << " }";
+		separator = ",\n";
+	}
+
+	out << "\n  ],\n  \"pcs\": [";
+	separator = "\n";
+	for (unsigned int pc : hottest(pcCounts, MEMORY_SIZE))
+	{
+		char text[DISASSEMBLY_LINE_LENGTH];
+		uint16_t opcode = static_cast<uint16_t>(memory[pc] << 8u | (pc + 1 < MEMORY_SIZE ? memory[pc + 1] : 0));
+		Disassembler::format(opcode, text, sizeof(text));
+		out << separator << "    { \"pc\": " << pc << ", \"count\": " << pcCounts[pc] << ", \"share\": "
+			<< std::setprecision(6) << pcCounts[pc] / total << ", \"instruction\": \"" << text << "\" }";
+		separator = ",\n";
+	}
+	out << "\n  ]\n}\n";
+	return out.good();
+}
+
+bool Profiler::writeListing(const std::string& file, const uint8_t* memory) const
+{
+	std::ofstream out(file, std::ios::trunc);
+	if (!out.is_open())
+	{
+		return false;
+	}
+	double total = instructions > 0 ? static_cast<double>(instructions) : 1.0;
+
+	out << "; " << instructions << " instructions\n;\n";
+	out << ";   share        count  kind     nanoseconds/call\n";
+	for (unsigned int kind : hottest(kindCounts, OP_KIND_COUNT))
+	{
+		out << ";  " << std::fixed << std::setprecision(2) << std::setw(6) << kindCounts[kind] * 100.0 / total << "%"
+			<< std::setw(13) << kindCounts[kind] << "  " << std::left << std::setw(4) << kindNames[kind] << std::right;
+		if (isTimed(static_cast<OpKind>(kind)))
+		{
+			out << std::setw(21) << std::setprecision(1) << static_cast<double>(kindNanoseconds[kind]) / kindCounts[kind];
+		}
+		out << "\n";
+	}
+	out << ";\n;   share        count  addr   code  instruction\n";
+
+	Disassembler disassembler;
+	disassembler.refresh(memory, 0, MEMORY_SIZE);
+	unsigned int next = 0;	//address after the last line printed
+	for (unsigned int pc = 0; pc < MEMORY_SIZE; ++pc)
+	{
+		if (pcCounts[pc] == 0)
+		{
+			continue;
+		}
+		if (next != 0 && pc != next)
+		{
+			out << "             ...\n";
+		}
+		out << "  " << std::setprecision(2) << std::setw(6) << pcCounts[pc] * 100.0 / total << "%"
+			<< std::setw(13) << pcCounts[pc] << "  " << disassembler.line(pc) << "\n";
+		next = pc + 2;
+	}
+	return out.good();
+}
+
+#endif
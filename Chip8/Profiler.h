@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Chip8.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+	Where a guest program spends its time: executions per instruction kind and per pc, plus host
+	time for the handlers that cost more than a few nanoseconds (see isTimed).
+
+	Profiling is compiled in only when CHIP8_PROFILE is defined; without it Chip8 has no profiler
+	hooks at all. With it, Chip8::setProfiler attaches one, and while one is attached every engine
+	runs the profiling interpreter, so the counts are per instruction whatever the engine.
+*/
+
+class Profiler
+{
+public:
+	Profiler();
+
+	void reset();
+
+	//the kinds whose handlers get timed; the rest are counted only, since a clock read would cost more
+	//than they do
+	static constexpr bool isTimed(OpKind kind)
+	{
+		return kind == OpKind::Op00E0 || kind == OpKind::OpDxyn || kind == OpKind::OpFx33
+			|| kind == OpKind::OpFx55 || kind == OpKind::OpFx65;
+	}
+
+	void count(uint16_t pc, OpKind kind)
+	{
+		++instructions;
+		++kindCounts[static_cast<size_t>(kind)];
+		++pcCounts[pc];
+	}
+
+	void addTime(OpKind kind, std::chrono::steady_clock::duration time)
+	{
+		kindNanoseconds[static_cast<size_t>(kind)] += std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+	}
+
+	//"Dxyn" for OpKind::OpDxyn, "Null" for Null
+	static const char* kindName(OpKind kind);
+
+	//the counts as JSON: totals, every kind executed and every pc executed, hottest first;
+	//memory is disassembled for the pcs' instructions; false if the file can't be written
+	bool writeJson(const std::string& file, const uint8_t* memory) const;
+
+	//every executed address of memory disassembled in address order, each with its share of the
+	//instructions and its count, gaps between runs of code marked; false if the file can't be written
+	bool writeListing(const std::string& file, const uint8_t* memory) const;
+
+	uint64_t instructions;
+	uint64_t kindCounts[OP_KIND_COUNT];
+	uint64_t kindNanoseconds[OP_KIND_COUNT];	//only for timed kinds
+	uint64_t pcCounts[MEMORY_SIZE];
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+	The generator behind OP_Cxkk: SplitMix64. Its whole state is one uint64_t that counts up by a
+	fixed odd constant, so any value, 0 included, is a good seed, a save state can hold it as is,
+	and a draw is an add, two multiplies and three shifts. The same seed gives the same bytes on
+	every compiler and platform, which std::default_random_engine doesn't promise.
+*/
+
+//next byte from state, 0-255; the top byte of the output, the best mixed one
+inline uint8_t randomByte(uint64_t& state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return static_cast<uint8_t>((z ^ (z >> 31)) >> 56);
+}
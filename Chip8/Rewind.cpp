@@ -0,0 +1,281 @@
+#include "Rewind.h"
+#include <cstring>
+
+const size_t STATE_WORDS = sizeof(SaveState) / 8;
+//a delta is runs of: uint16_t unchanged words to skip, uint16_t changed words, then those words XORed
+const size_t RUN_HEADER_BYTES = 4;
+const size_t MAX_DELTA_BYTES = RUN_HEADER_BYTES + STATE_WORDS * (RUN_HEADER_BYTES + 8);
+
+static_assert(sizeof(SaveState) % 8 == 0, "deltas work in whole words");
+
+static uint64_t loadWord(const uint8_t* bytes, size_t word)
+{
+	uint64_t value;
+	memcpy(&value, bytes + word * 8, sizeof(value));
+	return value;
+}
+
+// before XOR after as runs of changed words; an unchanged state still gets one empty run, so no
+// entry is zero bytes long
+static size_t encodeDelta(const SaveState& before, const SaveState& after, uint8_t* out)
+{
+	const uint8_t* a = reinterpret_cast<const uint8_t*>(&before);
+	const uint8_t* b = reinterpret_cast<const uint8_t*>(&after);
+	size_t length = 0;
+	size_t word = 0;
+	do
+	{
+		size_t skip = 0;
+		while (word + skip < STATE_WORDS && loadWord(a, word + skip) == loadWord(b, word + skip))
+		{
+			++skip;
+		}
+		size_t changed = 0;
+		while (word + skip + changed < STATE_WORDS && loadWord(a, word + skip + changed) != loadWord(b, word + skip + changed))
+		{
+			++changed;
+		}
+		if (changed == 0 && length > 0)
+		{
+			break;	//only unchanged words left
+		}
+
+		uint16_t header[2] = { static_cast<uint16_t>(skip), static_cast<uint16_t>(changed) };
+		memcpy(out + length, header, RUN_HEADER_BYTES);
+		length += RUN_HEADER_BYTES;
+		word += skip;
+		for (size_t i = 0; i < changed; ++i, ++word)
+		{
+			uint64_t difference = loadWord(a, word) ^ loadWord(b, word);
+			memcpy(out + length, &difference, sizeof(difference));
+			length += sizeof(difference);
+		}
+	} while (word < STATE_WORDS);
+	return length;
+}
+
+// XOR a delta into state: takes the frame before it to the frame after, or the other way round
+static void applyDelta(SaveState& state, const uint8_t* delta, size_t length)
+{
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(&state);
+	const uint8_t* end = delta + length;
+	size_t word = 0;
+	while (delta < end)
+	{
+		uint16_t header[2];
+		memcpy(header, delta, RUN_HEADER_BYTES);
+		delta += RUN_HEADER_BYTES;
+		word += header[0];
+		for (unsigned int i = 0; i < header[1]; ++i, ++word, delta += 8)
+		{
+			uint64_t value = loadWord(bytes, word) ^ loadWord(delta, 0);
+			memcpy(bytes + word * 8, &value, sizeof(value));
+		}
+	}
+}
+
+Rewind::Rewind(size_t bufferBytes, unsigned int maxFrames, unsigned int keyframeInterval)
+	: buffer(new uint8_t[bufferBytes]), capacity(bufferBytes),
+	entries(new Entry[maxFrames > 0 ? maxFrames : 1]), maxFrames(maxFrames > 0 ? maxFrames : 1),
+	keyframeInterval(keyframeInterval > 0 ? keyframeInterval : 1), encoded(new uint8_t[MAX_DELTA_BYTES])
+{}
+
+Rewind::~Rewind() = default;
+
+Rewind::Entry& Rewind::entry(unsigned int frame)
+{
+	return entries[(first + frame) % maxFrames];
+}
+
+void Rewind::record(Chip8& chip8)
+{
+	dropAfterCursor();
+	chip8.saveState(captured);
+
+	bool keyframe = count == 0 || sinceKeyframe + 1 >= keyframeInterval;
+	size_t length = sizeof(SaveState);
+	if (!keyframe)
+	{
+		length = encodeDelta(current, captured, encoded.get());
+		//everything changed: the state itself is smaller
+		keyframe = length >= sizeof(SaveState);
+	}
+
+	size_t offset = 0;
+	if (!keyframe && !allocate(length, false, offset))
+	{
+		//the ring only holds this keyframe's frames and they fill it: start over from a keyframe
+		keyframe = true;
+	}
+	if (keyframe)
+	{
+		length = sizeof(SaveState);
+		if (!allocate(length, true, offset))
+		{
+			return;	//the buffer can't hold a single state
+		}
+	}
+	memcpy(&buffer[offset], keyframe ? reinterpret_cast<const uint8_t*>(&captured) : encoded.get(), length);
+
+	entries[(first + count) % maxFrames] = { offset, static_cast<uint32_t>(length), keyframe };
+	++count;
+	cursor = count - 1;
+	used += length;
+	keyframes += keyframe ? 1 : 0;
+	sinceKeyframe = keyframe ? 0 : sinceKeyframe + 1;
+	current = captured;
+}
+
+bool Rewind::stepBack(Chip8& chip8)
+{
+	if (cursor == 0)
+	{
+		return false;
+	}
+
+	Entry& at = entry(cursor);
+	if (!at.keyframe)
+	{
+		applyDelta(current, &buffer[at.offset], at.length);
+	}
+	else
+	{
+		//a keyframe doesn't say what came before it: replay from the keyframe before
+		//(the oldest frame is always a keyframe, so there is one)
+		unsigned int frame = cursor - 1;
+		while (!entry(frame).keyframe)
+		{
+			--frame;
+		}
+		memcpy(&current, &buffer[entry(frame).offset], sizeof(SaveState));
+		for (++frame; frame < cursor; ++frame)
+		{
+			applyDelta(current, &buffer[entry(frame).offset], entry(frame).length);
+		}
+	}
+	--cursor;
+	return chip8.loadState(current);
+}
+
+bool Rewind::stepForward(Chip8& chip8)
+{
+	if (cursor + 1 >= count)
+	{
+		return false;
+	}
+
+	++cursor;
+	Entry& at = entry(cursor);
+	if (at.keyframe)
+	{
+		memcpy(&current, &buffer[at.offset], sizeof(SaveState));
+	}
+	else
+	{
+		applyDelta(current, &buffer[at.offset], at.length);
+	}
+	return chip8.loadState(current);
+}
+
+void Rewind::clear()
+{
+	first = 0;
+	count = 0;
+	cursor = 0;
+	keyframes = 0;
+	sinceKeyframe = 0;
+	used = 0;
+}
+
+unsigned int Rewind::frames() const
+{
+	return count;
+}
+
+unsigned int Rewind::position() const
+{
+	return cursor;
+}
+
+size_t Rewind::bytesUsed() const
+{
+	return used;
+}
+
+// find length contiguous bytes after the newest entry, wrapping to the start of the buffer when the
+// end is too short; drops the oldest keyframes until there's room, but for a delta never the newest
+// keyframe, which the delta needs
+bool Rewind::allocate(size_t length, bool keyframe, size_t& offset)
+{
+	while (true)
+	{
+		if (count == 0)
+		{
+			offset = 0;
+			return length <= capacity;
+		}
+		if (count < maxFrames)
+		{
+			size_t head = entry(0).offset;
+			const Entry& newest = entry(count - 1);
+			size_t tail = newest.offset + newest.length;
+			if (newest.offset >= head)
+			{
+				//not wrapped: free space is after tail and before head
+				if (tail + length <= capacity)
+				{
+					offset = tail;
+					return true;
+				}
+				if (length <= head)
+				{
+					offset = 0;
+					return true;
+				}
+			}
+			else if (tail + length <= head)
+			{
+				offset = tail;
+				return true;
+			}
+		}
+		if (!keyframe && keyframes <= 1)
+		{
+			return false;
+		}
+		dropOldestKeyframe();
+	}
+}
+
+void Rewind::dropOldestKeyframe()
+{
+	do
+	{
+		used -= entry(0).length;
+		keyframes -= entry(0).keyframe ? 1 : 0;
+		first = (first + 1) % maxFrames;
+		--count;
+		cursor = cursor > 0 ? cursor - 1 : 0;
+	} while (count > 0 && !entry(0).keyframe);
+}
+
+void Rewind::dropAfterCursor()
+{
+	if (count == 0 || cursor + 1 == count)
+	{
+		return;
+	}
+	while (count > cursor + 1)
+	{
+		Entry& newest = entry(count - 1);
+		used -= newest.length;
+		keyframes -= newest.keyframe ? 1 : 0;
+		--count;
+	}
+	unsigned int frame = cursor;
+	while (!entry(frame).keyframe)
+	{
+		--frame;
+	}
+	sinceKeyframe = cursor - frame;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "SaveState.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+	Rewind history: the last frames of a Chip8, one SaveState per frame, kept in a byte ring
+	allocated once.
+
+	Every keyframeInterval frames the whole state is stored (a keyframe); the frames in between are
+	stored as the XOR of the state with the frame before, with runs of unchanged 8-byte words
+	skipped. Most frames only change a few registers and some video rows, so a delta is tens of
+	bytes. XOR works in both directions, so stepping back or forward a frame applies one delta to
+	the current state; only stepping back past a keyframe replays from the keyframe before it.
+
+	When the ring is full the oldest keyframe and its deltas go, so the oldest frame held is always
+	a keyframe.
+*/
+
+class Rewind
+{
+public:
+	//up to maxFrames frames in bufferBytes of history, a keyframe every keyframeInterval frames
+	Rewind(size_t bufferBytes, unsigned int maxFrames, unsigned int keyframeInterval);
+	~Rewind();
+
+	//add chip8 as the newest frame; after stepping back, the frames past the current one are dropped first
+	void record(Chip8& chip8);
+
+	//move to the frame before/after the current one and load it into chip8; false at either end
+	bool stepBack(Chip8& chip8);
+	bool stepForward(Chip8& chip8);
+
+	void clear();
+
+	unsigned int frames() const;	//frames held
+	unsigned int position() const;	//the current frame, 0 = oldest held
+	size_t bytesUsed() const;	//stored keyframes and deltas
+
+private:
+	struct Entry
+	{
+		size_t offset;	//into buffer
+		uint32_t length;
+		bool keyframe;
+	};
+
+	std::unique_ptr<uint8_t[]> buffer;
+	size_t capacity;
+	std::unique_ptr<Entry[]> entries;	//ring of maxFrames, oldest at first
+	unsigned int maxFrames;
+	unsigned int keyframeInterval;
+	unsigned int first = 0;
+	unsigned int count = 0;
+	unsigned int cursor = 0;	//current frame, counted from first
+	unsigned int keyframes = 0;
+	unsigned int sinceKeyframe = 0;
+	size_t used = 0;
+
+	SaveState current;	//the state of frame cursor
+	SaveState captured;	//scratch for record()
+	std::unique_ptr<uint8_t[]> encoded;	//scratch for a delta before it goes in the ring
+
+	Entry& entry(unsigned int frame);
+	bool allocate(size_t length, bool keyframe, size_t& offset);
+	void dropOldestKeyframe();
+	void dropAfterCursor();
+};
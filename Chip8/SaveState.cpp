@@ -0,0 +1,30 @@
+#include "SaveState.h"
+#include "MappedFile.h"
+#include <fstream>
+
+bool writeSaveState(const std::string& file, const SaveState& state)
+{
+	std::ofstream out(file, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+	{
+		return false;
+	}
+	out.write(reinterpret_cast<const char*>(&state), sizeof(state));
+	return out.good();
+}
+
+const SaveState* mapSaveState(MappedFile& mapping, const std::string& file)
+{
+	if (!mapping.open(file))
+	{
+		return nullptr;
+	}
+	//mappings are page aligned, which covers the struct's alignment
+	const SaveState* state = reinterpret_cast<const SaveState*>(mapping.data());
+	if (mapping.size() != sizeof(SaveState) || !isSaveState(*state))
+	{
+		mapping.close();
+		return nullptr;
+	}
+	return state;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Chip8.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+class MappedFile;
+
+const uint32_t SAVE_STATE_VERSION = 2;
+const char SAVE_STATE_MAGIC[4] = { 'C', '8', 'S', 'T' };
+
+/*
+	Everything a Chip8 needs to carry on from where it was, in one fixed layout.
+
+	A save state file is exactly this struct, little-endian, with no padding the compiler could move
+	(checked below), so it can be mapped and used in place. Settings that aren't machine state,
+	like the engine and packed video, aren't saved. Bump SAVE_STATE_VERSION whenever the layout or
+	the meaning of a field changes; loading refuses any other version.
+*/
+
+struct SaveState
+{
+	char magic[4];	//SAVE_STATE_MAGIC
+	uint32_t version;	//SAVE_STATE_VERSION
+	uint32_t size;	//sizeof(SaveState)
+	uint32_t reserved0;
+	uint64_t randomState;	//OP_Cxkk's generator, see Random.h
+	uint16_t stack[STACK_LEVELS];
+	uint16_t pc;
+	uint16_t index;
+	uint16_t opcode;	//last instruction executed, for the debugger
+	uint8_t sp;
+	uint8_t delayTimer;
+	uint8_t soundTimer;
+	uint8_t reserved1[15];
+	uint8_t registers[REGISTER_COUNT];
+	uint8_t keypad[KEY_COUNT];
+	uint8_t memory[MEMORY_SIZE];
+	uint8_t video[VIDEO_WIDTH * VIDEO_HEIGHT];	//byte per pixel, 0xFF on
+};
+
+static_assert(offsetof(SaveState, randomState) == 16, "save state layout changed");
+static_assert(offsetof(SaveState, pc) == 56, "save state layout changed");
+static_assert(offsetof(SaveState, registers) == 80, "save state layout changed");
+static_assert(offsetof(SaveState, memory) == 112, "save state layout changed");
+static_assert(offsetof(SaveState, video) == 4208, "save state layout changed");
+static_assert(sizeof(SaveState) == 6256, "save state layout changed");
+
+//write state to file as is; false if the file can't be written
+bool writeSaveState(const std::string& file, const SaveState& state);
+
+//map file and return the state in it, or nullptr if it isn't a save state this build can load;
+//the state points into mapping, so it stays valid until mapping is closed
+const SaveState* mapSaveState(MappedFile& mapping, const std::string& file);
+
+//header and range checks shared by mapSaveState and Chip8::loadState
+//inline, so the core doesn't need SaveState.cpp just to load a state from memory
+inline bool isSaveState(const SaveState& state)
+{
+	return memcmp(state.magic, SAVE_STATE_MAGIC, sizeof(state.magic)) == 0
+		&& state.version == SAVE_STATE_VERSION
+		&& state.size == sizeof(SaveState)
+		&& state.sp <= STACK_LEVELS;	//any pc is fine, fetches wrap it
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include "Chip8.h"
+#include "Random.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+	What every instruction does to the state it touches, written once. Chip8's handlers and the
+	lane by lane path of BatchChip8 both call these, so the two engines can't drift apart the way
+	two hand-written copies did.
+
+	Registers and the stack come in as Strided views, because Chip8 keeps them one after another and
+	a BatchChip8 block keeps them structure-of-arrays (register r of a lane is BATCH_WIDTH bytes past
+	register r - 1). Everything else is passed by reference. Where x or y is F the register
+	references alias, so the order VF and Vx are written in below is part of the semantics.
+
+	pc is already past the instruction when these run, as in the handlers. Video here is the byte
+	per pixel layout; Chip8's packed video draws and clears on its own.
+*/
+
+//element i of an array whose elements are STRIDE Ts apart
+template <typename T, size_t STRIDE>
+struct Strided
+{
+	T* base;
+
+	T& operator()(unsigned int i) const
+	{
+		return base[i * STRIDE];
+	}
+};
+
+inline void exec00E0(uint8_t* video)
+{
+	memset(video, 0, VIDEO_WIDTH * VIDEO_HEIGHT);
+}
+
+template <typename Stack>
+inline void exec00EE(Stack stack, uint8_t& sp, uint16_t& pc)
+{
+	--sp;
+	pc = stack(sp);
+}
+
+inline void exec1nnn(const Instruction& op, uint16_t& pc)
+{
+	pc = op.nnn;
+}
+
+template <typename Stack>
+inline void exec2nnn(const Instruction& op, Stack stack, uint8_t& sp, uint16_t& pc)
+{
+	stack(sp) = pc;
+	pc = op.nnn;
+	++sp;
+}
+
+//the skips: true when the next instruction is skipped
+template <typename Registers>
+inline bool skip3xkk(const Instruction& op, Registers V)
+{
+	return V(op.x) == op.kk;
+}
+
+template <typename Registers>
+inline bool skip4xkk(const Instruction& op, Registers V)
+{
+	return V(op.x) != op.kk;
+}
+
+template <typename Registers>
+inline bool skip5xy0(const Instruction& op, Registers V)
+{
+	return V(op.x) == V(op.y);
+}
+
+template <typename Registers>
+inline bool skip9xy0(const Instruction& op, Registers V)
+{
+	return V(op.x) != V(op.y);
+}
+
+template <typename Registers>
+inline bool skipEx9E(const Instruction& op, Registers V, const uint8_t* keypad)
+{
+	return keypad[V(op.x)] != 0;
+}
+
+template <typename Registers>
+inline bool skipExA1(const Instruction& op, Registers V, const uint8_t* keypad)
+{
+	return keypad[V(op.x)] == 0;
+}
+
+//any of the skips above; false for an instruction that isn't one
+template <typename Registers>
+inline bool skipTaken(const Instruction& op, Registers V, const uint8_t* keypad)
+{
+	switch (op.kind)
+	{
+	case OpKind::Op3xkk: return skip3xkk(op, V);
+	case OpKind::Op4xkk: return skip4xkk(op, V);
+	case OpKind::Op5xy0: return skip5xy0(op, V);
+	case OpKind::Op9xy0: return skip9xy0(op, V);
+	case OpKind::OpEx9E: return skipEx9E(op, V, keypad);
+	case OpKind::OpExA1: return skipExA1(op, V, keypad);
+	default: return false;
+	}
+}
+
+template <typename Registers>
+inline void exec6xkk(const Instruction& op, Registers V)
+{
+	V(op.x) = op.kk;
+}
+
+template <typename Registers>
+inline void exec7xkk(const Instruction& op, Registers V)
+{
+	V(op.x) += op.kk;
+}
+
+template <typename Registers>
+inline void exec8xy0(const Instruction& op, Registers V)
+{
+	V(op.x) = V(op.y);
+}
+
+template <typename Registers>
+inline void exec8xy1(const Instruction& op, Registers V)
+{
+	V(op.x) |= V(op.y);
+}
+
+template <typename Registers>
+inline void exec8xy2(const Instruction& op, Registers V)
+{
+	V(op.x) &= V(op.y);
+}
+
+template <typename Registers>
+inline void exec8xy3(const Instruction& op, Registers V)
+{
+	V(op.x) ^= V(op.y);
+}
+
+//carry into VF, then the sum into Vx: with x = F the sum wins
+template <typename Registers>
+inline void exec8xy4(const Instruction& op, Registers V)
+{
+	uint16_t sum = V(op.x) + V(op.y);
+	V(0xF) = sum > 255U ? 1 : 0;
+	V(op.x) = sum & 0xFFu;
+}
+
+//8xy5-8xyE set VF first and compute Vx from the registers after, VF included
+template <typename Registers>
+inline void exec8xy5(const Instruction& op, Registers V)
+{
+	V(0xF) = V(op.x) > V(op.y) ? 1 : 0;
+	V(op.x) -= V(op.y);
+}
+
+template <typename Registers>
+inline void exec8xy6(const Instruction& op, Registers V)
+{
+	V(0xF) = V(op.x) & 0x1u;	//LSB
+	V(op.x) >>= 1;
+}
+
+template <typename Registers>
+inline void exec8xy7(const Instruction& op, Registers V)
+{
+	V(0xF) = V(op.y) > V(op.x) ? 1 : 0;
+	V(op.x) = V(op.y) - V(op.x);
+}
+
+template <typename Registers>
+inline void exec8xyE(const Instruction& op, Registers V)
+{
+	V(0xF) = (V(op.x) & 0x80u) >> 7u;	//MSB
+	V(op.x) <<= 1;
+}
+
+inline void execAnnn(const Instruction& op, uint16_t& index)
+{
+	index = op.nnn;
+}
+
+template <typename Registers>
+inline void execBnnn(const Instruction& op, Registers V, uint16_t& pc)
+{
+	pc = V(0) + op.nnn;
+}
+
+template <typename Registers>
+inline void execCxkk(const Instruction& op, Registers V, uint64_t& randomState)
+{
+	V(op.x) = randomByte(randomState) & op.kk;
+}
+
+//the start position wraps around the screen, the sprite itself is clipped at the edges
+template <typename Registers>
+inline void execDxyn(const Instruction& op, Registers V, const uint8_t* memory, uint16_t index, uint8_t* video)
+{
+	uint8_t x = V(op.x) % VIDEO_WIDTH;
+	uint8_t y = V(op.y) % VIDEO_HEIGHT;
+	V(0xF) = 0;
+
+	for (unsigned int i = 0; i < op.n && y + i < VIDEO_HEIGHT; ++i)
+	{
+		for (unsigned int j = 0; j < 8 && x + j < VIDEO_WIDTH; ++j)
+		{
+			uint8_t spritePixel = memory[index + i] & (0x80u >> j);
+			uint8_t* screenPixel = &video[(y + i) * VIDEO_WIDTH + (x + j)];
+			if (spritePixel)
+			{
+				if (*screenPixel == 0xFF)
+				{
+					V(0xF) = 1;
+				}
+				*screenPixel ^= 0xFF;
+			}
+		}
+	}
+}
+
+template <typename Registers>
+inline void execFx07(const Instruction& op, Registers V, uint8_t delayTimer)
+{
+	V(op.x) = delayTimer;
+}
+
+//the lowest key that is down into Vx, true; false with Vx untouched when none is, and the
+//instruction has to run again
+template <typename Registers>
+inline bool execFx0A(const Instruction& op, Registers V, const uint8_t* keypad)
+{
+	for (uint8_t i = 0; i < KEY_COUNT; ++i)
+	{
+		if (keypad[i])
+		{
+			V(op.x) = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename Registers>
+inline void execFx15(const Instruction& op, Registers V, uint8_t& delayTimer)
+{
+	delayTimer = V(op.x);
+}
+
+template <typename Registers>
+inline void execFx18(const Instruction& op, Registers V, uint8_t& soundTimer)
+{
+	soundTimer = V(op.x);
+}
+
+template <typename Registers>
+inline void execFx1E(const Instruction& op, Registers V, uint16_t& index)
+{
+	index += V(op.x);
+}
+
+template <typename Registers>
+inline void execFx29(const Instruction& op, Registers V, uint16_t& index)
+{
+	index = FONTSET_START_ADDRESS + (5 * V(op.x));
+}
+
+//writes memory[index, index + 3)
+template <typename Registers>
+inline void execFx33(const Instruction& op, Registers V, uint8_t* memory, uint16_t index)
+{
+	uint8_t value = V(op.x);
+	memory[index + 2] = value % 10;
+	value /= 10;
+	memory[index + 1] = value % 10;
+	value /= 10;
+	memory[index] = value % 10;
+}
+
+//writes memory[index, index + x + 1)
+template <typename Registers>
+inline void execFx55(const Instruction& op, Registers V, uint8_t* memory, uint16_t index)
+{
+	for (uint8_t i = 0; i <= op.x; ++i)
+	{
+		memory[index + i] = V(i);
+	}
+}
+
+template <typename Registers>
+inline void execFx65(const Instruction& op, Registers V, const uint8_t* memory, uint16_t index)
+{
+	for (uint8_t i = 0; i <= op.x; ++i)
+	{
+		V(i) = memory[index + i];
+	}
+}
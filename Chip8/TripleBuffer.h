@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+	Lock-free single-producer/single-consumer triple buffer.
+
+	The writer fills back() and calls publish(); the reader calls acquire() and reads front().
+	Each side owns one slot and the third is handed over through one atomic exchange, so neither
+	thread ever waits on the other and the reader always sees the newest finished slot.
+	Frames published faster than the reader acquires them are dropped.
+*/
+
+template <typename T>
+class TripleBuffer
+{
+public:
+	//slot the writer fills before publish()
+	T& back()
+	{
+		return slots[backIndex];
+	}
+
+	//hand back() over as the newest slot and take the spare one to write next; false if the slot
+	//published before was never acquired, so the reader dropped it
+	bool publish()
+	{
+		uint8_t previous = middle.exchange(static_cast<uint8_t>(backIndex | FRESH), std::memory_order_acq_rel);
+		backIndex = previous & INDEX_MASK;
+		return (previous & FRESH) == 0;
+	}
+
+	//switch front() to the newest published slot; false if nothing was published since the last call
+	bool acquire()
+	{
+		if (!(middle.load(std::memory_order_acquire) & FRESH))
+		{
+			return false;
+		}
+		uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+		frontIndex = previous & INDEX_MASK;
+		return true;
+	}
+
+	//slot the reader is working with
+	const T& front() const
+	{
+		return slots[frontIndex];
+	}
+
+private:
+	static const uint8_t INDEX_MASK = 0x3;
+	static const uint8_t FRESH = 0x4;	//set in middle when it holds a slot the reader hasn't seen
+
+	T slots[3]{};
+	uint8_t backIndex = 0;	//writer only
+	std::atomic<uint8_t> middle{ 1 };
+	uint8_t frontIndex = 2;	//reader only
+};
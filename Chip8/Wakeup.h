@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+/*
+	Lets one thread sleep until another has something for it, e.g. the window thread until the
+	emulation thread publishes a frame into a TripleBuffer.
+
+	signal() is one atomic store and one atomic load while the other thread is awake; only when it
+	is asleep in waitFor() does signal() take the mutex, to wake it. So a producer that signals
+	every frame never contends with a consumer that is busy presenting.
+
+	A signal left over from before waitFor() makes it return at once; the caller checks for work
+	anyway, so at worst that costs one extra pass.
+*/
+
+class Wakeup
+{
+public:
+	//wake a waitFor() in progress, or make the next one return at once
+	void signal()
+	{
+		//seq_cst with waitFor's store and exchange: either it sees sleeping, or waitFor sees signalled
+		signalled.store(true);
+		if (sleeping.load())
+		{
+			//taking the lock means the sleeper is inside wait_for, or gone, so the notify can't be missed
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+			}
+			wake.notify_one();
+		}
+	}
+
+	//block until signal() or timeout passes; true if signalled. Clears the signal
+	template <typename Rep, typename Period>
+	bool waitFor(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		sleeping.store(true);
+		bool woken = wake.wait_for(lock, timeout, [this] { return signalled.exchange(false); });
+		sleeping.store(false);
+		return woken;
+	}
+
+private:
+	std::atomic<bool> signalled{ false };
+	std::atomic<bool> sleeping{ false };
+	std::mutex mutex;
+	std::condition_variable wake;
+};
@@ -1,44 +1,318 @@
 #include "Chip8.h"
 #include "Display.h"
+#include "Movie.h"
+#include "Rewind.h"
+#include "TripleBuffer.h"
+#include "Wakeup.h"
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
+
+const unsigned int DEFAULT_PANEL_REFRESH_RATE = 10;	//Hz
+const unsigned int DEFAULT_REWIND_SECONDS = 300;
+const size_t REWIND_BUFFER_BYTES = 8 * 1024 * 1024;	//~10 minutes of a typical game
+const unsigned int REWIND_KEYFRAME_INTERVAL = TIMER_FREQUENCY;	//a keyframe a second
+
+// everything the main thread needs to present one finished emulation frame
+struct Frame
+{
+	uint8_t video[VIDEO_WIDTH * VIDEO_HEIGHT];
+	uint8_t registers[REGISTER_COUNT];
+	uint16_t stack[STACK_LEVELS];
+	uint16_t opcode;
+	uint16_t pc;
+	uint16_t index;
+	uint8_t sp;
+	uint8_t delayTimer;
+	uint32_t dirtyRows;	//rows changed since the last frame the main thread acquired (bit n = row n)
+	char listing[LISTING_LINES * DISASSEMBLY_LINE_LENGTH];
+};
+
+// Emulation thread. Frames run at the timer rate: copy in the keypad, run a batch of instructions
+// with one timer tick, publish the result and signal the main thread, then sleep until the next
+// frame's deadline.
+// Presentation happens on the main thread, so a slow window.display() never holds this loop up.
+// The disassembly listing lives here too: only memory the program wrote gets re-disassembled.
+// Without the debug panel there's no listing to keep.
+// With a rewind history every frame is recorded, and while rewind is held frames step back through
+// it instead of running.
+// With a movie and replay, the keypad comes from the movie until it runs out, then from the keyboard.
+// With a movie and no replay, every keypad change is recorded into it; rewinding drops the changes
+// of the frames rewound over, so the movie is the run as it finally played out.
+static void emulate(Chip8& chip8, int instructionsPerFrame, bool listing, Rewind* history, Movie* movie, bool replay,
+	TripleBuffer<Frame>& frames, Wakeup& published, const std::atomic<uint16_t>& keys, const std::atomic<bool>& rewind,
+	const std::atomic<bool>& running)
+{
+	std::unique_ptr<Disassembler> disassembler;
+	if (listing)
+	{
+		disassembler = std::make_unique<Disassembler>();
+	}
+
+	const auto frameDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(1.0 / TIMER_FREQUENCY));
+	auto nextFrame = std::chrono::steady_clock::now();
+	uint64_t frameNumber = 0;	//frames run since boot
+	size_t nextEvent = 0;
+	uint32_t droppedRows = 0;	//rows of published frames the main thread may never acquire, carried into the next one
+
+	while (running.load(std::memory_order_relaxed))
+	{
+		bool replaying = replay && frameNumber < movie->frames;
+		if (replaying)
+		{
+			while (nextEvent < movie->events.size() && movie->events[nextEvent].frame <= frameNumber)
+			{
+				chip8.keypad[movie->events[nextEvent].key] = movie->events[nextEvent].state;
+				++nextEvent;
+			}
+		}
+		else
+		{
+			uint16_t keyState = keys.load(std::memory_order_relaxed);
+			for (unsigned int i = 0; i < KEY_COUNT; ++i)
+			{
+				uint8_t state = (keyState >> i) & 1u;
+				if (movie && !replay && chip8.keypad[i] != state)
+				{
+					movie->events.push_back({ frameNumber, static_cast<uint8_t>(i), state });
+				}
+				chip8.keypad[i] = state;
+			}
+		}
+
+		if (history && !replaying && rewind.load(std::memory_order_relaxed))
+		{
+			if (history->stepBack(chip8))
+			{
+				--frameNumber;
+				while (movie && !replay && !movie->events.empty() && movie->events.back().frame >= frameNumber)
+				{
+					movie->events.pop_back();
+				}
+			}
+		}
+		else
+		{
+			chip8.runFrame(instructionsPerFrame);
+			++frameNumber;
+			if (history)
+			{
+				history->record(chip8);
+			}
+		}
+		if (movie && !replay)
+		{
+			movie->frames = frameNumber;
+		}
+
+		Frame& frame = frames.back();
+		memcpy(frame.video, chip8.getVideo(), sizeof(frame.video));
+		memcpy(frame.registers, chip8.getRegisters(), sizeof(frame.registers));
+		memcpy(frame.stack, chip8.getStack(), sizeof(frame.stack));
+		frame.opcode = chip8.getOpcode();
+		frame.pc = chip8.getProgramCounter();
+		frame.index = chip8.getIndex();
+		frame.sp = chip8.getStackPointer();
+		frame.delayTimer = chip8.getDelayTimer();
+		uint32_t changedRows = chip8.takeDirtyRows();
+		frame.dirtyRows = droppedRows | changedRows;
+		if (disassembler)
+		{
+			unsigned int first, last;
+			if (chip8.takeWrittenMemory(first, last))
+			{
+				disassembler->refresh(chip8.getMemory(), first, last - first);
+			}
+			disassembler->window(frame.pc, LISTING_LINES, frame.listing);
+		}
+		// the main thread may skip frames: while it does, their rows carry over into the next one
+		droppedRows = frames.publish() ? changedRows : droppedRows | changedRows;
+		published.signal();
+
+		// deadlines are absolute so sleep overshoot doesn't accumulate into drift;
+		// after a long stall (more than a frame behind) start counting from now instead of catching up
+		nextFrame += frameDuration;
+		auto now = std::chrono::steady_clock::now();
+		if (now - nextFrame > frameDuration)
+		{
+			nextFrame = now;
+		}
+		std::this_thread::sleep_until(nextFrame);
+	}
+}
+
+// "RRGGBB" in hex to an opaque RGBA colour
+static bool parseColour(const std::string& text, uint8_t* rgba)
+{
+	if (text.size() != 6 || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+	{
+		return false;
+	}
+	unsigned long value = std::stoul(text, nullptr, 16);
+	rgba[0] = static_cast<uint8_t>(value >> 16);
+	rgba[1] = static_cast<uint8_t>(value >> 8);
+	rgba[2] = static_cast<uint8_t>(value);
+	rgba[3] = 0xFF;
+	return true;
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " <Scale> <Instructions per frame> <ROM> [--no-panel] [--panel-hz <N>] [--rewind-seconds <N>]"
+		" [--seed <N>] [--record <Movie> | --play <Movie>] [--palette <On RRGGBB> <Off RRGGBB>]\n";
+	std::exit(EXIT_FAILURE);
+}
 
 int main(int argc, char** argv)
 {
-	if (argc != 4)
+	if (argc < 4)
 	{
-		std::cerr << "Usage: " << argv[0] << " <Scale <Delay> <ROM>\n";
-		std::exit(EXIT_FAILURE);
+		usage(argv[0]);
 	}
 
 	int videoScale = std::stoi(argv[1]);
-	int cycleDelay = std::stoi(argv[2]);
+	int instructionsPerFrame = std::stoi(argv[2]);
 	std::string rom = argv[3];
+	unsigned int panelRefreshRate = DEFAULT_PANEL_REFRESH_RATE;
+	unsigned int rewindSeconds = DEFAULT_REWIND_SECONDS;
+	uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::string recordFile;
+	std::string playFile;
+	Palette palette = DEFAULT_PALETTE;
 
-	Display display("CHIP-8 Emulator", 64, 32, videoScale);
+	for (int i = 4; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--no-panel")
+		{
+			panelRefreshRate = 0;
+		}
+		else if (arg == "--panel-hz" && i + 1 < argc)
+		{
+			panelRefreshRate = std::stoul(argv[++i]);
+		}
+		else if (arg == "--rewind-seconds" && i + 1 < argc)
+		{
+			rewindSeconds = std::stoul(argv[++i]);
+		}
+		else if (arg == "--seed" && i + 1 < argc)
+		{
+			seed = std::stoull(argv[++i]);
+		}
+		else if (arg == "--record" && i + 1 < argc && playFile.empty())
+		{
+			recordFile = argv[++i];
+		}
+		else if (arg == "--play" && i + 1 < argc && recordFile.empty())
+		{
+			playFile = argv[++i];
+		}
+		else if (arg == "--palette" && i + 2 < argc)
+		{
+			if (!parseColour(argv[++i], palette.on) || !parseColour(argv[++i], palette.off))
+			{
+				usage(argv[0]);
+			}
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	// a movie being played brings its own seed and instructions per frame
+	Movie movie;
+	if (!playFile.empty())
+	{
+		if (!loadMovie(playFile, movie))
+		{
+			std::exit(EXIT_FAILURE);
+		}
+		seed = movie.seed;
+		instructionsPerFrame = movie.instructionsPerFrame;
+	}
+
+	Display display("CHIP-8 Emulator", 64, 32, videoScale, panelRefreshRate, palette);
 
 	Chip8 chip8;
-	chip8.loadROM(rom);
+	chip8.setSeed(seed);
+	if (!chip8.loadROM(rom))
+	{
+		std::exit(EXIT_FAILURE);
+	}
+	if (!playFile.empty() && hashImage(chip8.getMemory()) != movie.romHash)
+	{
+		std::cerr << "Movie " << playFile << " was recorded on a different ROM" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if (!recordFile.empty())
+	{
+		movie.seed = seed;
+		movie.romHash = hashImage(chip8.getMemory());
+		movie.instructionsPerFrame = instructionsPerFrame;
+	}
+	bool useMovie = !playFile.empty() || !recordFile.empty();
+
+	// 0 seconds turns rewind off
+	std::unique_ptr<Rewind> history;
+	if (rewindSeconds > 0)
+	{
+		history = std::make_unique<Rewind>(REWIND_BUFFER_BYTES, rewindSeconds * TIMER_FREQUENCY, REWIND_KEYFRAME_INTERVAL);
+	}
+
+	// keypad goes to the emulation thread as one atomic bitmask (bit n = key n)
+	uint8_t keys[KEY_COUNT]{};
+	std::atomic<uint16_t> keyState{ 0 };
+	std::atomic<bool> rewind{ false };
+	std::atomic<bool> running{ true };
+	TripleBuffer<Frame> frames;
+	Wakeup published;
+	const auto frameDuration = std::chrono::duration<double>(1.0 / TIMER_FREQUENCY);
+
+	std::thread emulation(emulate, std::ref(chip8), instructionsPerFrame, panelRefreshRate > 0, history.get(),
+		useMovie ? &movie : nullptr, !playFile.empty(), std::ref(frames), std::ref(published), std::cref(keyState), std::cref(rewind), std::cref(running));
 
-	auto lastCycleTime = std::chrono::high_resolution_clock::now();
 	bool quit = false;
 
 	while (!quit)
 	{
-		quit = display.processInput(chip8.keypad);
-
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
+		quit = display.processInput(keys);
 
-		if (dt > cycleDelay)
+		uint16_t keyBits = 0;
+		for (unsigned int i = 0; i < KEY_COUNT; ++i)
 		{
-			lastCycleTime = currentTime;
+			keyBits |= (keys[i] ? 1u : 0u) << i;
+		}
+		keyState.store(keyBits, std::memory_order_relaxed);
+		rewind.store(display.isRewinding(), std::memory_order_relaxed);
 
-			chip8.cycle();
-			display.updateDisplay(chip8.video, chip8.getOpcode(), chip8.getProgramCounter(), chip8.getIndex(), 
-				chip8.getStackPointer(), chip8.getDelayTimer(), chip8.getRegisters(), chip8.getStack());
+		if (frames.acquire())
+		{
+			// the first frame has every row dirty, since the core starts out that way
+			const Frame& frame = frames.front();
+			display.updateDisplay(frame.video, frame.dirtyRows, frame.opcode, frame.pc, frame.index,
+				frame.sp, frame.delayTimer, frame.registers, frame.stack, frame.listing);
+		}
+		else
+		{
+			// nothing new yet: sleep until the emulation thread publishes, at most a frame so window
+			// events still get handled if it stalls; no wakeups in between, even when blocked on Fx0A
+			published.waitFor(frameDuration);
 		}
 	}
 
+	running.store(false, std::memory_order_relaxed);
+	emulation.join();
+
+	if (!recordFile.empty() && !writeMovie(recordFile, movie))
+	{
+		std::cerr << "Could not write movie " << recordFile << std::endl;
+		return EXIT_FAILURE;
+	}
+
 	return 0;
-}
\ No newline at end of file
+}
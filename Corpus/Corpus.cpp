@@ -0,0 +1,294 @@
+#include "Session.h"
+#include "WorkStealingPool.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Corpus runner: runs every job in a job file as its own Chip8, spread over all cores with a
+// work-stealing pool, then reports each job's result and the aggregate throughput.
+// Only links the core, no SFML.
+
+const unsigned int DEFAULT_INSTRUCTIONS_PER_FRAME = 10;
+
+struct Job
+{
+	size_t rom;	//index into the loaded ROM images
+	size_t script;	//index into the loaded scripts, 0 = no input
+	uint64_t cycles;
+	std::string romFile;
+};
+
+struct JobResult
+{
+	bool loaded;	//false: the ROM didn't fit in memory and the job never ran
+	uint64_t hash;
+	uint8_t registers[REGISTER_COUNT];
+	uint64_t instructions;
+	double seconds;
+};
+
+// Job file format: one "<ROM> <cycles> [<script>]" per line, lines starting with '#' are comments
+// Each distinct ROM and script is read once, however many jobs use it
+static bool loadJobs(const std::string& file, std::vector<Job>& jobs, std::vector<std::vector<uint8_t>>& roms,
+	std::vector<std::vector<KeyEvent>>& scripts)
+{
+	std::ifstream list(file);
+	if (!list.is_open())
+	{
+		std::cerr << "Could not open job file " << file << std::endl;
+		return false;
+	}
+
+	std::map<std::string, size_t> romIndex;
+	std::map<std::string, size_t> scriptIndex;
+	scripts.emplace_back();
+
+	std::string line;
+	while (std::getline(list, line))
+	{
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		std::istringstream fields(line);
+		Job job{};
+		std::string scriptFile;
+		if (!(fields >> job.romFile >> job.cycles) || job.cycles == 0)
+		{
+			std::cerr << "Bad job line: " << line << std::endl;
+			return false;
+		}
+		fields >> scriptFile;
+
+		auto rom = romIndex.find(job.romFile);
+		if (rom == romIndex.end())
+		{
+			std::ifstream romStream(job.romFile, std::ios::binary);
+			if (!romStream.is_open())
+			{
+				std::cerr << "Could not open ROM " << job.romFile << std::endl;
+				return false;
+			}
+			roms.emplace_back(std::istreambuf_iterator<char>(romStream), std::istreambuf_iterator<char>());
+			rom = romIndex.emplace(job.romFile, roms.size() - 1).first;
+		}
+		job.rom = rom->second;
+
+		if (!scriptFile.empty())
+		{
+			auto script = scriptIndex.find(scriptFile);
+			if (script == scriptIndex.end())
+			{
+				scripts.emplace_back();
+				if (!loadScript(scriptFile, scripts.back()))
+				{
+					return false;
+				}
+				script = scriptIndex.emplace(scriptFile, scripts.size() - 1).first;
+			}
+			job.script = script->second;
+		}
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " <Jobs> [--threads <N>] [--ipf <N>] [--engine table|cached|jit|switch]"
+		" [--scaling]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		usage(argv[0]);
+	}
+
+	std::string jobFile = argv[1];
+	unsigned int threads = std::thread::hardware_concurrency();
+	unsigned int instructionsPerFrame = DEFAULT_INSTRUCTIONS_PER_FRAME;
+	Chip8::Engine engine = Chip8::Engine::Table;
+	bool scaling = false;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--scaling")
+		{
+			scaling = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			usage(argv[0]);
+		}
+		if (arg == "--threads")
+		{
+			threads = std::stoul(argv[++i]);
+		}
+		else if (arg == "--ipf")
+		{
+			instructionsPerFrame = std::stoul(argv[++i]);
+		}
+		else if (arg == "--engine")
+		{
+			std::string name = argv[++i];
+			if (name == "table")
+			{
+				engine = Chip8::Engine::Table;
+			}
+			else if (name == "cached")
+			{
+				engine = Chip8::Engine::Cached;
+			}
+			else if (name == "jit")
+			{
+				engine = Chip8::Engine::Jit;
+			}
+			else if (name == "switch")
+			{
+				engine = Chip8::Engine::Switch;
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+	if (instructionsPerFrame == 0)
+	{
+		usage(argv[0]);
+	}
+
+	std::vector<Job> jobs;
+	std::vector<std::vector<uint8_t>> roms;
+	std::vector<std::vector<KeyEvent>> scripts;
+	if (!loadJobs(jobFile, jobs, roms, scripts))
+	{
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::vector<JobResult> results(jobs.size());
+	auto runJob = [&](size_t i)
+	{
+		const Job& job = jobs[i];
+		JobResult& result = results[i];
+		auto start = std::chrono::steady_clock::now();
+
+		Chip8 chip8;
+		chip8.setEngine(engine);
+		chip8.setSeed(0);	//same hash every run, like the headless runner
+		result.loaded = chip8.loadROM(roms[job.rom].data(), roms[job.rom].size());
+		if (!result.loaded)
+		{
+			result = JobResult{};
+			return;
+		}
+		runSession(chip8, job.cycles, instructionsPerFrame, scripts[job.script]);
+
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.instructions = job.cycles;
+		result.hash = hashVideo(chip8.getVideo(), sizeof(chip8.video));
+		memcpy(result.registers, chip8.getRegisters(), sizeof(result.registers));
+	};
+
+	// one run at each thread count up to the requested one (powers of two, then the count itself)
+	std::vector<unsigned int> threadCounts;
+	if (scaling)
+	{
+		for (unsigned int count = 1; count < threads; count *= 2)
+		{
+			threadCounts.push_back(count);
+		}
+	}
+	threadCounts.push_back(threads);
+
+	std::vector<double> wallTimes;
+	size_t steals = 0;
+	for (unsigned int count : threadCounts)
+	{
+		WorkStealingPool pool(count);
+		auto start = std::chrono::steady_clock::now();
+		pool.run(jobs.size(), runJob);
+		wallTimes.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		steals = pool.steals();
+	}
+
+	// failed jobs ran nothing, so they count no instructions
+	uint64_t totalInstructions = 0;
+	for (const JobResult& result : results)
+	{
+		totalInstructions += result.instructions;
+	}
+
+	// results are from the last run, which used every requested thread
+	size_t failures = 0;
+	std::cout << std::hex << std::setfill('0');
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		const JobResult& result = results[i];
+		if (!result.loaded)
+		{
+			std::cout << "Job " << std::dec << i << ": " << jobs[i].romFile << " failed: ROM is too large\n";
+			++failures;
+			continue;
+		}
+		std::cout << "Job " << std::dec << i << ": " << jobs[i].romFile
+			<< " instructions " << result.instructions
+			<< " time " << std::fixed << std::setprecision(6) << result.seconds << " s"
+			<< " hash 0x" << std::hex << std::setw(16) << result.hash << " registers";
+		for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+		{
+			std::cout << " " << std::setw(2) << static_cast<int>(result.registers[r]);
+		}
+		std::cout << "\n";
+	}
+
+	double seconds = wallTimes.back();
+	std::cout << std::dec << std::setfill(' ');
+	std::cout << "Jobs: " << jobs.size() << "\n";
+	std::cout << "Failed: " << failures << "\n";
+	std::cout << "Threads: " << threads << "\n";
+	std::cout << "Instructions: " << totalInstructions << "\n";
+	std::cout << "Time: " << std::fixed << std::setprecision(6) << seconds << " s\n";
+	std::cout << "Instructions/sec: " << std::setprecision(0) << (seconds > 0 ? totalInstructions / seconds : 0.0) << "\n";
+	std::cout << "Jobs/sec: " << std::setprecision(1) << (seconds > 0 ? jobs.size() / seconds : 0.0) << "\n";
+	std::cout << "Steals: " << steals << "\n";
+
+	if (scaling)
+	{
+		// speedup against the single thread run; efficiency is speedup per thread
+		std::cout << "\nThreads  Time (s)    Instructions/sec  Speedup  Efficiency\n";
+		for (size_t i = 0; i < threadCounts.size(); ++i)
+		{
+			double speedup = wallTimes[i] > 0 ? wallTimes[0] / wallTimes[i] : 0.0;
+			std::cout << std::setw(7) << threadCounts[i]
+				<< std::setw(10) << std::setprecision(4) << wallTimes[i]
+				<< std::setw(20) << std::setprecision(0) << (wallTimes[i] > 0 ? totalInstructions / wallTimes[i] : 0.0)
+				<< std::setw(9) << std::setprecision(2) << speedup
+				<< std::setw(11) << std::setprecision(0) << 100.0 * speedup / threadCounts[i] << "%\n";
+		}
+	}
+
+	return failures > 0 ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Runs a batch of independent jobs on a fixed number of threads.
+
+	Jobs are dealt round-robin onto one deque per worker. A worker takes from the back of its own
+	deque and, once that's empty, steals from the front of another's, so a worker that drew a run of
+	long jobs doesn't leave the rest idle at the end. Each deque has its own lock; jobs are whole
+	emulator runs, so the locks are taken rarely compared to the work between them.
+*/
+
+class WorkStealingPool
+{
+public:
+	explicit WorkStealingPool(unsigned int threads)
+		: threadCount(threads > 0 ? threads : 1), queues(new Queue[threadCount])
+	{}
+
+	unsigned int size() const
+	{
+		return threadCount;
+	}
+
+	//call job(i) once for every i in [0, count), on the pool's threads (the caller is one of them)
+	//returns when every job is done
+	template <typename Job>
+	void run(size_t count, Job job)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			queues[i % threadCount].jobs.push_back(i);
+		}
+		stolen.store(0, std::memory_order_relaxed);
+
+		auto work = [this, &job](unsigned int worker)
+		{
+			size_t next;
+			while (take(worker, next))
+			{
+				job(next);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned int worker = 1; worker < threadCount; ++worker)
+		{
+			workers.emplace_back(work, worker);
+		}
+		work(0);
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	//jobs that ran on a different worker than they were dealt to, during the last run()
+	size_t steals() const
+	{
+		return stolen.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<size_t> jobs;
+	};
+
+	unsigned int threadCount;
+	std::unique_ptr<Queue[]> queues;
+	std::atomic<size_t> stolen{ 0 };
+
+	//nothing is added during a run, so once every queue is empty the worker is done
+	bool take(unsigned int worker, size_t& job)
+	{
+		{
+			Queue& own = queues[worker];
+			std::lock_guard<std::mutex> guard(own.lock);
+			if (!own.jobs.empty())
+			{
+				job = own.jobs.back();
+				own.jobs.pop_back();
+				return true;
+			}
+		}
+		for (unsigned int i = 1; i < threadCount; ++i)
+		{
+			Queue& victim = queues[(worker + i) % threadCount];
+			std::lock_guard<std::mutex> guard(victim.lock);
+			if (!victim.jobs.empty())
+			{
+				job = victim.jobs.front();
+				victim.jobs.pop_front();
+				stolen.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+};
@@ -0,0 +1,291 @@
+#include "MappedFile.h"
+#ifdef CHIP8_PROFILE
+#include "Profiler.h"
+#endif
+#include "SaveState.h"
+#include "Session.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Headless runner: runs a ROM with no window for a fixed budget, then reports
+// instructions/sec and a hash of the final video buffer. Only links the core, no SFML.
+// The random seed is fixed (0 unless --seed says otherwise), so the same command gives the same hash.
+
+const unsigned int DEFAULT_INSTRUCTIONS_PER_FRAME = 10;
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " <ROM> (--cycles <N> | --frames <N>) [--ipf <N>] [--seed <N>]"
+		" [--input <Script> | --movie <File>] [--record-movie <File>] [--engine table|cached|jit|switch]"
+		" [--packed-video] [--load-state <File>] [--save-state <File>]"
+		" [--profile <JSON>] [--profile-listing <File>]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		usage(argv[0]);
+	}
+
+	std::string rom = argv[1];
+	std::string scriptFile;
+	std::string movieFile;
+	std::string recordMovieFile;
+	std::string profileFile;
+	std::string profileListingFile;
+	std::string loadStateFile;
+	std::string saveStateFile;
+	uint64_t cycles = 0;
+	uint64_t frames = 0;
+	unsigned int instructionsPerFrame = DEFAULT_INSTRUCTIONS_PER_FRAME;
+	uint64_t seed = 0;
+	Chip8::Engine engine = Chip8::Engine::Table;
+	bool packedVideo = false;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--packed-video")
+		{
+			packedVideo = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			usage(argv[0]);
+		}
+		if (arg == "--cycles")
+		{
+			cycles = std::stoull(argv[++i]);
+		}
+		else if (arg == "--frames")
+		{
+			frames = std::stoull(argv[++i]);
+		}
+		else if (arg == "--ipf")
+		{
+			instructionsPerFrame = std::stoul(argv[++i]);
+		}
+		else if (arg == "--seed")
+		{
+			seed = std::stoull(argv[++i]);
+		}
+		else if (arg == "--input")
+		{
+			scriptFile = argv[++i];
+		}
+		else if (arg == "--movie")
+		{
+			movieFile = argv[++i];
+		}
+		else if (arg == "--record-movie")
+		{
+			recordMovieFile = argv[++i];
+		}
+		else if (arg == "--profile")
+		{
+			profileFile = argv[++i];
+		}
+		else if (arg == "--profile-listing")
+		{
+			profileListingFile = argv[++i];
+		}
+		else if (arg == "--load-state")
+		{
+			loadStateFile = argv[++i];
+		}
+		else if (arg == "--save-state")
+		{
+			saveStateFile = argv[++i];
+		}
+		else if (arg == "--engine")
+		{
+			std::string name = argv[++i];
+			if (name == "table")
+			{
+				engine = Chip8::Engine::Table;
+			}
+			else if (name == "cached")
+			{
+				engine = Chip8::Engine::Cached;
+			}
+			else if (name == "jit")
+			{
+				engine = Chip8::Engine::Jit;
+			}
+			else if (name == "switch")
+			{
+				engine = Chip8::Engine::Switch;
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	//a movie brings its own seed, instructions per frame and input, and its length is the default budget;
+	//movies start from boot, so neither playing nor recording one goes with a loaded state
+	Movie movie;
+	if (!movieFile.empty())
+	{
+		if (!scriptFile.empty() || !loadStateFile.empty() || !loadMovie(movieFile, movie))
+		{
+			usage(argv[0]);
+		}
+		seed = movie.seed;
+		instructionsPerFrame = movie.instructionsPerFrame;
+		if (cycles == 0 && frames == 0)
+		{
+			frames = movie.frames;
+		}
+	}
+	if (!recordMovieFile.empty() && !loadStateFile.empty())
+	{
+		usage(argv[0]);
+	}
+#ifndef CHIP8_PROFILE
+	if (!profileFile.empty() || !profileListingFile.empty())
+	{
+		std::cerr << "Profiling needs a build with CHIP8_PROFILE defined" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+#endif
+
+	if ((cycles == 0) == (frames == 0) || instructionsPerFrame == 0)
+	{
+		usage(argv[0]);
+	}
+	if (frames != 0)
+	{
+		cycles = frames * instructionsPerFrame;
+	}
+
+	std::vector<KeyEvent> events = movie.events;
+	if (!scriptFile.empty() && !loadScript(scriptFile, events))
+	{
+		std::exit(EXIT_FAILURE);
+	}
+
+	Chip8 chip8;
+	chip8.setEngine(engine);
+	chip8.setPackedVideo(packedVideo);
+	chip8.setSeed(seed);
+	if (!chip8.loadROM(rom))
+	{
+		std::exit(EXIT_FAILURE);
+	}
+	uint64_t romHash = hashImage(chip8.getMemory());
+	if (!movieFile.empty() && romHash != movie.romHash)
+	{
+		std::cerr << "Movie " << movieFile << " was recorded on a different ROM" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+
+	//resume from a save state instead of from boot; the state replaces everything loadROM did
+	if (!loadStateFile.empty())
+	{
+		auto loadStart = std::chrono::steady_clock::now();
+		MappedFile mapping;
+		const SaveState* state = mapSaveState(mapping, loadStateFile);
+		if (state == nullptr || !chip8.loadState(*state))
+		{
+			std::cerr << "Could not load state " << loadStateFile << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+		std::cout << "State load: " << std::fixed << std::setprecision(1) << loadSeconds * 1e6 << " us\n";
+	}
+
+#ifdef CHIP8_PROFILE
+	std::unique_ptr<Profiler> profiler;
+	if (!profileFile.empty() || !profileListingFile.empty())
+	{
+		profiler = std::make_unique<Profiler>();
+		chip8.setProfiler(profiler.get());
+	}
+#endif
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t frame = runSession(chip8, cycles, instructionsPerFrame, events);
+	auto end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+
+	std::cout << "Instructions: " << cycles << "\n";
+	std::cout << "Frames: " << frame << "\n";
+	std::cout << "Time: " << std::fixed << std::setprecision(6) << seconds << " s\n";
+	std::cout << "Instructions/sec: " << std::setprecision(0) << (seconds > 0 ? cycles / seconds : 0.0) << "\n";
+	std::cout << "Video hash: 0x" << std::hex << std::setw(16) << std::setfill('0')
+		<< hashVideo(chip8.getVideo(), sizeof(chip8.video)) << std::endl;
+
+	std::cout << "Elided: " << std::dec << chip8.getElidedInstructions() << "\n";
+
+	//only the cached engine runs superinstructions
+	const uint64_t* fusions = chip8.getFusionCounts();
+	for (size_t i = 1; i < FUSION_COUNT; ++i)
+	{
+		if (fusions[i] > 0)
+		{
+			std::cout << "Fused " << fusionName(static_cast<Fusion>(i)) << ": " << std::dec << fusions[i] << "\n";
+		}
+	}
+
+#ifdef CHIP8_PROFILE
+	if (!profileFile.empty() && !profiler->writeJson(profileFile, chip8.getMemory()))
+	{
+		std::cerr << "Could not write profile " << profileFile << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if (!profileListingFile.empty() && !profiler->writeListing(profileListingFile, chip8.getMemory()))
+	{
+		std::cerr << "Could not write profile listing " << profileListingFile << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+#endif
+
+	if (!recordMovieFile.empty())
+	{
+		Movie recorded;
+		recorded.seed = seed;
+		recorded.romHash = romHash;
+		recorded.frames = frame;
+		recorded.instructionsPerFrame = instructionsPerFrame;
+		for (const KeyEvent& event : events)
+		{
+			if (event.frame < frame)
+			{
+				recorded.events.push_back(event);
+			}
+		}
+		if (!writeMovie(recordMovieFile, recorded))
+		{
+			std::cerr << "Could not write movie " << recordMovieFile << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	if (!saveStateFile.empty())
+	{
+		SaveState state;
+		chip8.saveState(state);
+		if (!writeSaveState(saveStateFile, state))
+		{
+			std::cerr << "Could not write state " << saveStateFile << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+#include "Session.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool loadScript(const std::string& file, std::vector<KeyEvent>& events)
+{
+	std::ifstream script(file);
+	if (!script.is_open())
+	{
+		std::cerr << "Could not open script " << file << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(script, line))
+	{
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		std::istringstream fields(line);
+		uint64_t frame;
+		unsigned int key;
+		unsigned int state;
+		if (!(fields >> frame >> std::hex >> key >> std::dec >> state) || key >= KEY_COUNT)
+		{
+			std::cerr << "Bad script line: " << line << std::endl;
+			return false;
+		}
+		events.push_back({ frame, static_cast<uint8_t>(key), static_cast<uint8_t>(state ? 1 : 0) });
+	}
+
+	// keep file order for events on the same frame
+	std::stable_sort(events.begin(), events.end(),
+		[](const KeyEvent& a, const KeyEvent& b) { return a.frame < b.frame; });
+	return true;
+}
+
+uint64_t hashVideo(const uint8_t* video, size_t size)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= video[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+uint64_t runSession(Chip8& chip8, uint64_t cycles, unsigned int instructionsPerFrame,
+	const std::vector<KeyEvent>& events)
+{
+	size_t nextEvent = 0;
+	uint64_t executed = 0;
+	uint64_t frame = 0;
+
+	while (executed < cycles)
+	{
+		// apply this frame's input before running it
+		while (nextEvent < events.size() && events[nextEvent].frame <= frame)
+		{
+			chip8.keypad[events[nextEvent].key] = events[nextEvent].state;
+			++nextEvent;
+		}
+
+		uint64_t count = std::min<uint64_t>(instructionsPerFrame, cycles - executed);
+		if (count == instructionsPerFrame)
+		{
+			chip8.runFrame(instructionsPerFrame);
+		}
+		else
+		{
+			chip8.run(static_cast<unsigned int>(count));
+		}
+		executed += count;
+		++frame;
+	}
+	return frame;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Chip8.h"
+#include "Movie.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the headless tools share: input scripts, running a ROM for a budget, and hashing the result.
+// Input is a list of KeyEvents (Movie.h), from a script or a movie.
+
+// Script format: one "<frame> <key> <state>" per line, key in hex (0-F), state 1 = down, 0 = up
+// Lines starting with '#' are comments
+bool loadScript(const std::string& file, std::vector<KeyEvent>& events);
+
+// FNV-1a, so runs can be compared across builds and machines
+uint64_t hashVideo(const uint8_t* video, size_t size);
+
+// run cycles instructions in frames of instructionsPerFrame, applying each frame's events before it
+// a budget can end part way through a frame; that last frame gets no timer tick
+// returns the number of frames run
+uint64_t runSession(Chip8& chip8, uint64_t cycles, unsigned int instructionsPerFrame,
+	const std::vector<KeyEvent>& events);
@@ -0,0 +1,342 @@
+#include "BatchChip8.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Lockstep test: generates random self-modifying programs, runs each on BatchChip8 and on one scalar
+// Chip8 per instance, and compares every instance's whole state after every chunk of a few
+// instructions. The first difference fails the run (exit code 1). Instances get their own keys and
+// Cxkk seeds, and programs patch their own code with per-instance values, so lanes split, run apart
+// and merge again. Only links the core, no SFML.
+
+const unsigned int DEFAULT_PROGRAMS = 200;
+const unsigned int DEFAULT_INSTANCES = 40;	//a full lane block and part of another
+const unsigned int DEFAULT_STEPS = 2000;	//instructions per program, at most
+const unsigned int MAX_CHUNK = 24;	//instructions run between comparisons, at most
+const unsigned int BODY_SLOTS = 48;	//random instructions per program, before the jump back to the start
+const uint16_t DATA_ADDRESS = 0x400;	//where loads and stores go when they don't target code
+
+const Chip8::Engine ENGINES[] = { Chip8::Engine::Table, Chip8::Engine::Cached, Chip8::Engine::Jit, Chip8::Engine::Switch };
+
+static uint16_t slotAddress(unsigned int slot)
+{
+	return START_ADDRESS + slot * 2;
+}
+
+// an instruction that stays well defined whatever the registers hold, as its two bytes
+static uint16_t safeInstruction(std::mt19937_64& rng)
+{
+	const uint16_t families[] = { 0x3000, 0x4000, 0x6000, 0x7000, 0x8000, 0xC000 };
+	return families[rng() % 6] | (rng() & 0x0FFF);
+}
+
+// Body: BODY_SLOTS instructions, then a jump back to the start; a subroutine and a data area follow.
+// Everything is random except that jumps and calls land on the body or the subroutine, and stores that
+// patch code write whole instructions, some of their bytes drawn from Cxkk so each instance differs.
+static std::vector<uint8_t> generateProgram(std::mt19937_64& rng)
+{
+	std::vector<uint16_t> body;
+	uint16_t subroutine = slotAddress(BODY_SLOTS + 1);
+	while (body.size() < BODY_SLOTS)
+	{
+		uint16_t x = (rng() % 16) << 8;
+		uint16_t y = (rng() % 16) << 4;
+		uint16_t kk = rng() & 0xFF;
+		uint16_t slot = slotAddress(rng() % BODY_SLOTS);
+		switch (rng() % 16)
+		{
+		case 0:
+			body.push_back(safeInstruction(rng));
+			break;
+		case 1:
+			body.push_back(0x8000 | x | y | (rng() % 2 ? 0xE : rng() % 8));
+			break;
+		case 2:
+			body.push_back(0x5000 | x | y);
+			body.push_back(0x9000 | x | y);
+			break;
+		case 3:
+			body.push_back(0x1000 | slot);
+			break;
+		case 4:
+			body.push_back(0x2000 | subroutine);
+			break;
+		case 5:
+			//Bnnn with V0 small enough to stay in the body, or now and then past the end of memory, to wrap
+			if (rng() % 4 == 0)
+			{
+				body.push_back(0x6000 | (rng() & 0xFE));
+				body.push_back(0xBFFF);
+				break;
+			}
+			body.push_back(0x6000 | ((rng() % 4) * 2));
+			body.push_back(0xB000 | slotAddress(rng() % (BODY_SLOTS - 4)));
+			break;
+		case 6:
+			//patch a slot: the high byte fixed, the low byte the same everywhere or per instance
+			body.push_back(0x6000 | (safeInstruction(rng) >> 8));
+			body.push_back(rng() % 2 ? (0xC100 | kk) : (0x6100 | kk));
+			body.push_back(0xA000 | slot);
+			body.push_back(0xF155);
+			break;
+		case 7:
+			//BCD digits into code: they decode to Null
+			body.push_back(0xA000 | slot);
+			body.push_back(0xF033 | x);
+			break;
+		case 8:
+			body.push_back(0xA000 | (DATA_ADDRESS + (rng() % 0x80)));
+			body.push_back((rng() % 2 ? 0xF055 : 0xF065) | x);
+			break;
+		case 9:
+			body.push_back(0xA000 | (DATA_ADDRESS + (rng() % 0x80)));
+			body.push_back(0xF033 | x);
+			break;
+		case 10:
+			body.push_back(rng() % 2 ? 0xF029 | x : 0xF01E | x);
+			body.push_back(0xD000 | x | y | (rng() % 16));
+			break;
+		case 11:
+			body.push_back(rng() % 4 == 0 ? 0x00E0 : (0xD000 | x | y | (rng() % 16)));
+			break;
+		case 12:
+			body.push_back(0x6000 | x | (rng() % KEY_COUNT));
+			body.push_back((rng() % 2 ? 0xE09E : 0xE0A1) | x);
+			break;
+		case 13:
+			body.push_back(0xF00A | x);
+			break;
+		case 14:
+			body.push_back(rng() % 2 ? (0xF015 | x) : (0xF018 | x));
+			body.push_back(0xF007 | x);
+			break;
+		default:
+			body.push_back(0xC000 | x | kk);
+			break;
+		}
+	}
+	body.resize(BODY_SLOTS);
+	body.push_back(0x1000 | START_ADDRESS);
+	for (unsigned int i = 0; i < 3; ++i)
+	{
+		body.push_back(safeInstruction(rng));
+	}
+	body.push_back(0x00EE);
+
+	std::vector<uint8_t> image;
+	for (uint16_t opcode : body)
+	{
+		image.push_back(static_cast<uint8_t>(opcode >> 8));
+		image.push_back(static_cast<uint8_t>(opcode));
+	}
+	image.resize(DATA_ADDRESS + 0x100 - START_ADDRESS);
+	return image;
+}
+
+// whether the next instruction is defined on every machine: in memory, on the stack, on the keypad.
+// Random stores into code can build anything, so a program ends at the first one that isn't
+static bool nextIsSafe(Chip8& chip8)
+{
+	uint16_t pc = chip8.getProgramCounter() & ADDRESS_MASK;
+	const uint8_t* memory = chip8.getMemory();
+	Instruction op = decode((memory[pc] << 8u) | memory[(pc + 1) & ADDRESS_MASK]);
+	const uint8_t* V = chip8.getRegisters();
+	unsigned int index = chip8.getIndex();
+	switch (op.kind)
+	{
+	case OpKind::Op00EE: return chip8.getStackPointer() > 0;
+	case OpKind::Op2nnn: return chip8.getStackPointer() < STACK_LEVELS;
+	case OpKind::OpEx9E:
+	case OpKind::OpExA1: return V[op.x] < KEY_COUNT;
+	case OpKind::OpDxyn: return index + op.n <= MEMORY_SIZE;
+	case OpKind::OpFx33: return index + 3u <= MEMORY_SIZE;
+	case OpKind::OpFx55:
+	case OpKind::OpFx65: return index + op.x + 1u <= MEMORY_SIZE;
+	default: return true;
+	}
+}
+
+// what differs between an instance of the batch and its scalar machine, or nullptr
+static const char* compare(BatchChip8& batch, unsigned int instance, Chip8& chip8)
+{
+	if (batch.getProgramCounter(instance) != chip8.getProgramCounter())
+	{
+		return "pc";
+	}
+	if (batch.getIndex(instance) != chip8.getIndex())
+	{
+		return "index";
+	}
+	if (batch.getStackPointer(instance) != chip8.getStackPointer())
+	{
+		return "sp";
+	}
+	if (batch.getDelayTimer(instance) != chip8.getDelayTimer())
+	{
+		return "delay timer";
+	}
+	for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+	{
+		if (batch.getRegister(instance, r) != chip8.getRegisters()[r])
+		{
+			return "registers";
+		}
+	}
+	for (unsigned int level = 0; level < STACK_LEVELS; ++level)
+	{
+		if (batch.getStack(instance, level) != chip8.getStack()[level])
+		{
+			return "stack";
+		}
+	}
+	if (!std::equal(chip8.getMemory(), chip8.getMemory() + MEMORY_SIZE, batch.getMemory(instance)))
+	{
+		return "memory";
+	}
+	if (!std::equal(chip8.getVideo(), chip8.getVideo() + sizeof(chip8.video), batch.getVideo(instance)))
+	{
+		return "video";
+	}
+	return nullptr;
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " [--programs <N>] [--instances <N>] [--steps <N>] [--seed <N>] [--no-simd]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int programs = DEFAULT_PROGRAMS;
+	unsigned int instances = DEFAULT_INSTANCES;
+	unsigned int steps = DEFAULT_STEPS;
+	uint64_t seed = 0;
+	bool simd = true;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--programs" && i + 1 < argc)
+		{
+			programs = std::stoul(argv[++i]);
+		}
+		else if (arg == "--instances" && i + 1 < argc)
+		{
+			instances = std::stoul(argv[++i]);
+		}
+		else if (arg == "--steps" && i + 1 < argc)
+		{
+			steps = std::stoul(argv[++i]);
+		}
+		else if (arg == "--seed" && i + 1 < argc)
+		{
+			seed = std::stoull(argv[++i]);
+		}
+		else if (arg == "--no-simd")
+		{
+			simd = false;
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+	if (instances == 0)
+	{
+		usage(argv[0]);
+	}
+
+	uint64_t instructions = 0;
+	unsigned int cutShort = 0;
+	bool simdUsed = false;
+	for (unsigned int program = 0; program < programs; ++program)
+	{
+		// program n is the same for a given seed whatever else changes, so a failure can be rerun alone
+		std::mt19937_64 rng(seed + program);
+		std::vector<uint8_t> image = generateProgram(rng);
+		Chip8::Engine engine = ENGINES[program % 4];
+
+		BatchChip8 batch(instances);
+		batch.setSimd(simd);
+		simdUsed = batch.simdActive();
+		batch.loadROM(image.data(), image.size());
+		std::vector<Chip8> chip8s(instances);
+		for (unsigned int i = 0; i < instances; ++i)
+		{
+			chip8s[i].setEngine(engine);
+			chip8s[i].loadROM(image.data(), image.size());
+			chip8s[i].setSeed(seed + program + i);
+			batch.setSeed(i, seed + program + i);
+		}
+
+		unsigned int executed = 0;
+		bool safe = true;
+		while (executed < steps && safe)
+		{
+			// the scalar machines go first, one instruction at a time, so an undefined instruction is
+			// caught before the batch gets to it
+			unsigned int chunk = std::min<unsigned int>(1 + rng() % MAX_CHUNK, steps - executed);
+			for (unsigned int i = 0; i < instances && safe; ++i)
+			{
+				for (unsigned int n = 0; n < chunk && safe; ++n)
+				{
+					safe = nextIsSafe(chip8s[i]);
+					if (safe)
+					{
+						chip8s[i].run(1);
+					}
+				}
+			}
+			if (!safe)
+			{
+				++cutShort;
+				break;
+			}
+			batch.run(chunk);
+			executed += chunk;
+
+			for (unsigned int i = 0; i < instances; ++i)
+			{
+				const char* difference = compare(batch, i, chip8s[i]);
+				if (difference)
+				{
+					std::cout << "MISMATCH program " << program << " (seed " << seed << ") instance " << i
+						<< " after " << executed << " instructions: " << difference << "\n";
+					return EXIT_FAILURE;
+				}
+			}
+
+			// input and time move between chunks, the same on both sides
+			for (unsigned int i = 0; i < instances; ++i)
+			{
+				if (rng() % 4 == 0)
+				{
+					uint8_t key = rng() % KEY_COUNT;
+					uint8_t state = rng() % 2;
+					chip8s[i].keypad[key] = state;
+					batch.getKeypad(i)[key] = state;
+				}
+			}
+			if (rng() % 2 == 0)
+			{
+				batch.tickTimers();
+				for (Chip8& chip8 : chip8s)
+				{
+					chip8.tickTimers();
+				}
+			}
+		}
+		instructions += static_cast<uint64_t>(executed) * instances;
+	}
+
+	std::cout << "Programs: " << programs << " (" << cutShort << " stopped early at an undefined instruction)\n";
+	std::cout << "Instances: " << instances << (simdUsed ? " (AVX2)" : " (lane by lane)") << "\n";
+	std::cout << "Instructions compared: " << instructions << "\n";
+	std::cout << "OK\n";
+	return 0;
+}
@@ -0,0 +1,284 @@
+#include "Session.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// ROM suite: runs every ROM in a manifest for a fixed instruction count with scripted input, on each
+// engine, and reports guest MIPS, host ns/instruction and peak RSS. The final video hash of every run
+// is checked against the manifest's golden hash, so an engine can't get faster by getting it wrong.
+// Only links the core, no SFML.
+
+struct SuiteRom
+{
+	std::string name;
+	std::string romFile;
+	std::string scriptFile;	//"-" = no input
+	uint64_t instructions;
+	unsigned int instructionsPerFrame;
+	uint64_t golden;
+	bool hasGolden;	//"-" in the manifest: not recorded yet
+	size_t line;	//manifest line, for --update
+	std::vector<uint8_t> image;
+	std::vector<KeyEvent> events;
+};
+
+struct EngineName
+{
+	Chip8::Engine engine;
+	const char* name;
+};
+
+const EngineName ENGINES[] =
+{
+	{ Chip8::Engine::Table, "table" },
+	{ Chip8::Engine::Cached, "cached" },
+	{ Chip8::Engine::Jit, "jit" },
+	{ Chip8::Engine::Switch, "switch" },
+};
+
+// ROM and script paths are relative to the manifest's directory
+static std::string siblingPath(const std::string& manifest, const std::string& file)
+{
+	size_t slash = manifest.find_last_of("/\\");
+	return slash == std::string::npos ? file : manifest.substr(0, slash + 1) + file;
+}
+
+// Manifest format: one "<name> <ROM> <instructions> <ipf> <script> <golden hash>" per line, script and
+// hash "-" for none; lines starting with '#' are comments
+static bool loadManifest(const std::string& file, std::vector<std::string>& lines, std::vector<SuiteRom>& roms)
+{
+	std::ifstream manifest(file);
+	if (!manifest.is_open())
+	{
+		std::cerr << "Could not open manifest " << file << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(manifest, line))
+	{
+		lines.push_back(line);
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		std::istringstream fields(line);
+		SuiteRom rom{};
+		std::string golden;
+		if (!(fields >> rom.name >> rom.romFile >> rom.instructions >> rom.instructionsPerFrame >> rom.scriptFile >> golden)
+			|| rom.instructions == 0 || rom.instructionsPerFrame == 0)
+		{
+			std::cerr << "Bad manifest line: " << line << std::endl;
+			return false;
+		}
+		rom.hasGolden = golden != "-";
+		if (rom.hasGolden)
+		{
+			rom.golden = std::stoull(golden, nullptr, 16);
+		}
+		rom.line = lines.size() - 1;
+
+		std::ifstream romStream(siblingPath(file, rom.romFile), std::ios::binary);
+		if (!romStream.is_open())
+		{
+			std::cerr << "Could not open ROM " << rom.romFile << std::endl;
+			return false;
+		}
+		rom.image.assign(std::istreambuf_iterator<char>(romStream), std::istreambuf_iterator<char>());
+		if (rom.scriptFile != "-" && !loadScript(siblingPath(file, rom.scriptFile), rom.events))
+		{
+			return false;
+		}
+		roms.push_back(std::move(rom));
+	}
+	return true;
+}
+
+static std::string hexHash(uint64_t hash)
+{
+	std::ostringstream text;
+	text << "0x" << std::hex << std::setfill('0') << std::setw(16) << hash;
+	return text.str();
+}
+
+// the most memory the process has had resident, in KB
+static uint64_t peakResidentKB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0;
+	}
+	return counters.PeakWorkingSetSize / 1024;
+#else
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;	//bytes on macOS
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " <Manifest> [--engine table|cached|jit|switch|all] [--update]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		usage(argv[0]);
+	}
+
+	std::string manifestFile = argv[1];
+	std::vector<EngineName> engines(std::begin(ENGINES), std::end(ENGINES));
+	bool update = false;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--update")
+		{
+			update = true;
+		}
+		else if (arg == "--engine" && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			engines.clear();
+			for (const EngineName& engine : ENGINES)
+			{
+				if (name == "all" || name == engine.name)
+				{
+					engines.push_back(engine);
+				}
+			}
+			if (engines.empty())
+			{
+				usage(argv[0]);
+			}
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	std::vector<std::string> lines;
+	std::vector<SuiteRom> roms;
+	if (!loadManifest(manifestFile, lines, roms))
+	{
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::cout << std::left << std::setw(10) << "ROM" << std::setw(8) << "Engine" << std::right
+		<< std::setw(14) << "Instructions" << std::setw(10) << "MIPS" << std::setw(10) << "ns/instr"
+		<< "  " << std::left << std::setw(20) << "Hash" << "Result\n";
+
+	unsigned int failures = 0;
+	for (SuiteRom& rom : roms)
+	{
+		uint64_t firstHash = 0;
+		bool enginesAgree = true;
+		for (size_t e = 0; e < engines.size(); ++e)
+		{
+			// the seed is fixed, so Cxkk is part of what the hash checks
+			Chip8 chip8;
+			chip8.setEngine(engines[e].engine);
+			chip8.setSeed(0);
+			if (!chip8.loadROM(rom.image.data(), rom.image.size()))
+			{
+				std::cerr << "ROM is too large: " << rom.romFile << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			runSession(chip8, rom.instructions, rom.instructionsPerFrame, rom.events);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			uint64_t hash = hashVideo(chip8.getVideo(), sizeof(chip8.video));
+
+			if (e == 0)
+			{
+				firstHash = hash;
+			}
+			enginesAgree = enginesAgree && hash == firstHash;
+
+			const char* result = "NEW";
+			if (update)
+			{
+				result = hash == firstHash ? "OK" : "DIFFERS";
+			}
+			else if (rom.hasGolden)
+			{
+				result = hash == rom.golden ? "OK" : "MISMATCH";
+			}
+			if (!update && rom.hasGolden && hash != rom.golden)
+			{
+				++failures;
+			}
+
+			std::cout << std::left << std::setw(10) << rom.name << std::setw(8) << engines[e].name << std::right
+				<< std::setw(14) << rom.instructions << std::fixed
+				<< std::setw(10) << std::setprecision(1) << (seconds > 0 ? rom.instructions / seconds / 1e6 : 0.0)
+				<< std::setw(10) << std::setprecision(2) << seconds * 1e9 / rom.instructions
+				<< "  " << std::left << std::setw(20) << hexHash(hash) << result << "\n";
+		}
+
+		// a golden hash is only recorded when every engine produced it
+		if (update)
+		{
+			if (!enginesAgree)
+			{
+				std::cerr << "Engines disagree on " << rom.name << ", golden hash not updated" << std::endl;
+				++failures;
+				continue;
+			}
+			std::ostringstream line;
+			line << rom.name << " " << rom.romFile << " " << rom.instructions << " " << rom.instructionsPerFrame
+				<< " " << rom.scriptFile << " " << hexHash(firstHash);
+			lines[rom.line] = line.str();
+		}
+	}
+
+	std::cout << "Peak RSS: " << peakResidentKB() << " KB\n";
+
+	if (update)
+	{
+		std::ofstream manifest(manifestFile, std::ios::trunc);
+		for (const std::string& line : lines)
+		{
+			manifest << line << "\n";
+		}
+		if (!manifest)
+		{
+			std::cerr << "Could not write manifest " << manifestFile << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (failures > 0)
+	{
+		std::cout << failures << " run(s) failed\n";
+		return EXIT_FAILURE;
+	}
+	return 0;
+}